@@ -283,6 +283,26 @@ static int http_request_handler(void *cls, struct MHD_Connection *connection,
     return ret;
 }
 
+/* collect every exited child without blocking and log its completion */
+static void reap_children(void) {
+    int status; pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        pthread_mutex_lock(&tasks_lock);
+        for (int i = 0; i < task_count; ++i)
+            if (tasks[i].pid == pid) {
+                time_t end = time(NULL);
+                double delay = difftime(end, tasks[i].submitted_at);
+                total_delay_seconds += delay;
+                completed_tasks++;
+                timestamp_log(logfp_global);
+                fprintf(logfp_global, "[TASK] Completed: %s | PID: %d | Delay: %.0f sec\n", tasks[i].command, pid, delay);
+                fflush(logfp_global);
+                break;
+            }
+        pthread_mutex_unlock(&tasks_lock);
+    }
+}
+
 static void signal_handler(int sig) { exit_requested = 1; if (logfp_global) { timestamp_log(logfp_global); fprintf(logfp_global, "[INFO] Signal %d received\n", sig); fflush(logfp_global); } }
 
 int main(int argc, char *argv[]) {
@@ -323,24 +343,10 @@ int main(int argc, char *argv[]) {
             }
         }
         pthread_mutex_unlock(&tasks_lock);
-        int status; pid_t pid;
-        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-            pthread_mutex_lock(&tasks_lock);
-            for (int i = 0; i < task_count; ++i)
-                if (tasks[i].pid == pid) {
-                    time_t end = time(NULL);
-                    double delay = difftime(end, tasks[i].submitted_at);
-                    total_delay_seconds += delay;
-                    completed_tasks++;
-                    timestamp_log(logfp_global);
-                    fprintf(logfp_global, "[TASK] Completed: %s | PID: %d | Delay: %.0f sec\n", tasks[i].command, pid, delay);
-                    fflush(logfp_global);
-                    break;
-                }
-            pthread_mutex_unlock(&tasks_lock);
-        }
         if (index) free(index);
-        for (int s = 0; s < POLL_INTERVAL && !exit_requested; ++s) sleep(1);
+        /* reap every second so completions are logged promptly instead of once per poll */
+        for (int s = 0; s < POLL_INTERVAL && !exit_requested; ++s) { reap_children(); sleep(1); }
+        reap_children();
     }
     MHD_stop_daemon(daemon);
     timestamp_log(logfp_global);
@@ -0,0 +1,493 @@
+/* In-process microbenchmarks for main_code.c.
+ *
+ * Build (same libraries as the daemon):
+ *   gcc -O2 -o bench_scheduler bench_scheduler.c -lcurl -ljson-c -lmicrohttpd -lpthread
+ * Run:
+ *   ./bench_scheduler
+ */
+#define _GNU_SOURCE
+#define SCHEDULER_NO_MAIN
+#include <stdint.h>
+#include <stdlib.h>
+
+/* heap allocations made by the daemon's own code: main_code.c is compiled with its malloc,
+ * calloc and realloc calls routed through these counters, which works with any C library
+ * or allocator (ASan included). allocations inside libcurl and json-c are not counted;
+ * the request path makes none. */
+static uint64_t bench_allocs;
+
+static void *bench_malloc(size_t n) { __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED); return malloc(n); }
+static void *bench_calloc(size_t count, size_t n) { __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED); return calloc(count, n); }
+static void *bench_realloc(void *p, size_t n) { __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED); return realloc(p, n); }
+
+#define malloc(n) bench_malloc(n)
+#define calloc(count, n) bench_calloc(count, n)
+#define realloc(p, n) bench_realloc(p, n)
+#include "main_code.c"
+#undef malloc
+#undef calloc
+#undef realloc
+
+#define BENCH_BATCH 10000
+#define BENCH_QUEUE_MAX 1000000
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *bench_command(const char *cmd) { return command_compile(cmd, strlen(cmd), NULL, NULL); }
+
+/* ingest BENCH_BATCH fresh tasks plus BENCH_BATCH duplicates per round, the
+ * same dedup + append sequence http_request_handler runs under tasks_lock */
+static void bench_dedup_ingest(void) {
+    char cmd[64];
+    time_t base = 1730822400;
+    printf("%-12s %-14s %-14s\n", "queue_size", "ns/new_task", "ns/dup_task");
+    for (int round = 0; task_live < BENCH_QUEUE_MAX; ++round) {
+        double t0 = now_sec();
+        pthread_mutex_lock(&tasks_lock);
+        for (int i = 0; i < BENCH_BATCH; ++i) {
+            int id = round * BENCH_BATCH + i;
+            snprintf(cmd, sizeof(cmd), "sleep %d", id);
+            if (!tasks_contains(cmd, base + id)) tasks_append(bench_command(cmd), URGENCY_LOW, REGION_ANY, 24, base + id);
+        }
+        pthread_mutex_unlock(&tasks_lock);
+        double t1 = now_sec();
+        int dups = 0;
+        pthread_mutex_lock(&tasks_lock);
+        for (int i = 0; i < BENCH_BATCH; ++i) {
+            int id = (int)(((uint64_t)i * 2654435761u) % (uint64_t)task_live);
+            snprintf(cmd, sizeof(cmd), "sleep %d", id);
+            dups += tasks_contains(cmd, base + id);
+        }
+        pthread_mutex_unlock(&tasks_lock);
+        double t2 = now_sec();
+        if (dups != BENCH_BATCH) { fprintf(stderr, "dedup miss: %d/%d\n", dups, BENCH_BATCH); exit(1); }
+        if ((round + 1) % 10 == 0)
+            printf("%-12d %-14.1f %-14.1f\n", task_live, (t1 - t0) * 1e9 / BENCH_BATCH, (t2 - t1) * 1e9 / BENCH_BATCH);
+    }
+}
+
+/* steady-state churn: keep BENCH_BATCH tasks live while 10^6 pass through launch and
+ * completion (pid map lookup + retirement); the arena must not grow past the live set */
+static void bench_churn(void) {
+    char cmd[64];
+    int live[BENCH_BATCH];
+    pid_t next_pid = 1000;
+    double t0 = now_sec();
+    pthread_mutex_lock(&tasks_lock);
+    for (int id = 0; id < BENCH_QUEUE_MAX; ++id) {
+        int k = id % BENCH_BATCH;
+        if (id >= BENCH_BATCH) {
+            int slot = pid_map_take(task_hot[live[k]].pid);
+            if (slot != live[k]) { fprintf(stderr, "pid map mismatch\n"); exit(1); }
+            tasks_retire(slot);
+        }
+        snprintf(cmd, sizeof(cmd), "churn %d", id);
+        live[k] = tasks_append(bench_command(cmd), URGENCY_LOW, REGION_ANY, 24, id);
+        task_hot[live[k]].pid = next_pid;
+        pid_map_insert(next_pid++, live[k]);
+    }
+    pthread_mutex_unlock(&tasks_lock);
+    double t1 = now_sec();
+    printf("%d tasks through %d live: %.1f ns/task, arena slots %d\n",
+           BENCH_QUEUE_MAX, BENCH_BATCH, (t1 - t0) * 1e9 / BENCH_QUEUE_MAX, task_count);
+}
+
+static void bench_reset(void) {
+    for (int i = 0; i < task_count; ++i)
+        if (task_hot[i].state != TASK_FREE) { if (task_hot[i].pid > 0) pid_map_take(task_hot[i].pid); tasks_retire(i); }
+    task_active_count = 0;
+}
+
+/* full pass over the hot task fields (state, urgency, deadline), as queue-depth reporting
+ * does; the cold command strings are never touched */
+static void bench_hot_scan(void) {
+    int counts[URGENCY_COUNT] = {0};
+    time_t cutoff = 1730822400 + task_live / 2;
+    double t0 = now_sec();
+    for (int rep = 0; rep < 10; ++rep)
+        for (int i = 0; i < task_count; ++i)
+            if (task_hot[i].state == TASK_PENDING && task_hot[i].deadline < cutoff + 24 * 3600) counts[task_hot[i].urgency]++;
+    double t1 = now_sec();
+    printf("%d slots: %.2f ns/task, %zu bytes/task scanned (%d due)\n",
+           task_count, (t1 - t0) * 1e9 / (10.0 * task_count), sizeof(TaskHot), counts[URGENCY_LOW] / 10);
+}
+
+/* launches/sec of "true" with a growing touched heap: spawn_command (the daemon path)
+ * against the old fork+execvp, whose page-table copy scales with the parent's RSS */
+#define BENCH_LAUNCHES 500
+
+static double bench_launch_rate(int use_spawn) {
+    char *argv[] = {"true", NULL};
+    double t0 = now_sec();
+    for (int i = 0; i < BENCH_LAUNCHES; ++i) {
+        pid_t pid;
+        if (use_spawn) { if (spawn_command(argv, environ, URGENCY_MEDIUM, &pid) != 0) exit(1); }
+        else if ((pid = fork()) == 0) { execvp(argv[0], argv); _exit(127); }
+        waitpid(pid, NULL, 0);
+    }
+    return BENCH_LAUNCHES / (now_sec() - t0);
+}
+
+static void bench_launch(void) {
+    size_t ballast_mb[] = {0, 128, 512};
+    printf("%-12s %-14s %-14s\n", "heap_mb", "spawn/sec", "fork/sec");
+    for (size_t i = 0; i < sizeof(ballast_mb) / sizeof(ballast_mb[0]); ++i) {
+        size_t bytes = ballast_mb[i] << 20;
+        char *ballast = bytes ? malloc(bytes) : NULL;
+        if (ballast) memset(ballast, 1, bytes);
+        double spawn_rate = bench_launch_rate(1);
+        double fork_rate = bench_launch_rate(0);
+        printf("%-12zu %-14.0f %-14.0f\n", ballast_mb[i], spawn_rate, fork_rate);
+        free(ballast);
+    }
+}
+
+/* empty every pending heap, in every region group, and the depth gauges that mirror them */
+static void bench_pending_clear(void) {
+    for (int g = 0; g < PENDING_GROUPS; ++g)
+        for (int r = 0; r < URGENCY_COUNT; ++r) pending[g][r].count = 0;
+    memset(depth_gauges, 0, sizeof(depth_gauges));
+}
+
+/* drop every in-memory structure, as a restart would */
+static void bench_forget(void) {
+    bench_reset();
+    free(task_hot); free(task_cold); free(task_index);
+    task_hot = NULL; task_cold = NULL; task_index = NULL;
+    task_count = task_live = task_capacity = 0;
+    task_free_head = -1;
+    task_index_capacity = task_index_count = 0;
+    bench_pending_clear();
+}
+
+/* pending heap push and pop (what replaced the urgency insertion sort) at growing queue
+ * sizes; two thirds low, one third medium, deadlines spread over 48 hours */
+static void bench_pending(void) {
+    char cmd[64];
+    int *slots = malloc(sizeof(int) * BENCH_QUEUE_MAX);
+    printf("%-12s %-14s %-14s\n", "queue_size", "ns/push", "ns/pop");
+    for (int size = BENCH_BATCH; size <= BENCH_QUEUE_MAX; size *= 10) {
+        pthread_mutex_lock(&tasks_lock);
+        for (int i = 0; i < size; ++i) {
+            snprintf(cmd, sizeof(cmd), "pending %d", i);
+            slots[i] = tasks_append(bench_command(cmd), i % 3 ? URGENCY_LOW : URGENCY_MEDIUM, REGION_ANY,
+                                    1 + (int)((uint32_t)i * 2654435761u % 48), 1730822400 + i % 3600);
+        }
+        double t0 = now_sec();
+        for (int i = 0; i < size; ++i) pending_push(slots[i]);
+        double t1 = now_sec();
+        int popped = 0;
+        for (int r = 0; r < URGENCY_COUNT; ++r)
+            for (time_t last = 0; pending[PENDING_ANY][r].count > 0; ++popped) {
+                time_t key = pending[PENDING_ANY][r].items[0].key;
+                if (key < last) { fprintf(stderr, "pending heap out of order\n"); exit(1); }
+                last = key;
+                pending_pop(&pending[PENDING_ANY][r]);
+            }
+        double t2 = now_sec();
+        pthread_mutex_unlock(&tasks_lock);
+        if (popped != size) { fprintf(stderr, "pending heap lost tasks: %d/%d\n", popped, size); exit(1); }
+        printf("%-12d %-14.1f %-14.1f\n", size, (t1 - t0) * 1e9 / size, (t2 - t1) * 1e9 / size);
+        bench_forget();
+    }
+    free(slots);
+}
+
+/* completion handling: BENCH_LAUNCHES children of "true" go through a launch batch as the
+ * scheduler loop would start them; once they have all exited, the completion watcher is
+ * timed reaping them (pidfd wake-up, wait4, usage accounting, retirement) */
+static void bench_completion(void) {
+    char cmd[64];
+    LaunchBatch batch = {0};
+    if (reap_epoll_fd < 0 && reap_init() != 0) { fprintf(stderr, "reap_init failed\n"); exit(1); }
+    tasks_lock_acquire();
+    for (int i = 0; i < BENCH_LAUNCHES; ++i) {
+        snprintf(cmd, sizeof(cmd), "true %d", i);
+        launch_batch_add(&batch, tasks_append(bench_command(cmd), URGENCY_HIGH, REGION_ANY, 1, time(NULL)), 0);
+    }
+    tasks_lock_release();
+    double t0 = now_sec();
+    launch_batch_run(&batch);
+    double t1 = now_sec();
+    usleep(500000);   /* let every child exit before the watcher starts */
+    pthread_t watcher;
+    double t2 = now_sec();
+    pthread_create(&watcher, NULL, task_completion_watcher, NULL);
+    for (;;) {
+        tasks_lock_acquire();
+        int live = task_live;
+        tasks_lock_release();
+        if (live == 0) break;
+        sched_yield();
+    }
+    double t3 = now_sec();
+    exit_requested = 1;
+    uint64_t one = 1;
+    if (write(reap_wake_fd, &one, sizeof(one)) < 0) exit(1);
+    pthread_join(watcher, NULL);
+    exit_requested = 0;
+    printf("%d tasks: launch %.1f us/task, completion %.1f us/task\n", BENCH_LAUNCHES,
+           (t1 - t0) * 1e6 / BENCH_LAUNCHES, (t3 - t2) * 1e6 / BENCH_LAUNCHES);
+    free(batch.items);
+    bench_forget();
+}
+
+static void bench_journal_unlink(const char *prefix) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s.snap", prefix);
+    unlink(path);
+    for (int seq = 0; seq < 8; ++seq) { snprintf(path, sizeof(path), "%s.%d.wal", prefix, seq); unlink(path); }
+}
+
+/* durable submits in batches of BENCH_BATCH (one group commit each), a snapshot at 90%
+ * (with the tasks_lock time it costs), then a crash-style restart: recovery maps the
+ * snapshot and replays the remaining tail */
+static void bench_journal(void) {
+    char cmd[64];
+    const char *prefix = "/tmp/bench_scheduler_journal";
+    bench_forget();
+    bench_journal_unlink(prefix);
+    journal_prefix = prefix;
+    if (journal_start() != 0) { fprintf(stderr, "journal start failed\n"); exit(1); }
+    double t0 = now_sec(), t_submit = 0, t_compact = 0;
+    uint64_t held = 0;
+    for (int id = 0; id < BENCH_QUEUE_MAX; id += BENCH_BATCH) {
+        if (id == BENCH_QUEUE_MAX - BENCH_QUEUE_MAX / 10) {
+            t_submit += now_sec() - t0;
+            uint64_t held0 = histograms[HIST_LOCK_HOLD].sum_us;
+            t0 = now_sec();
+            journal_compact();
+            held = histograms[HIST_LOCK_HOLD].sum_us - held0;
+            t_compact = now_sec() - t0;
+            t0 = now_sec();
+        }
+        uint64_t lsn = 0;
+        pthread_mutex_lock(&tasks_lock);
+        for (int i = id; i < id + BENCH_BATCH; ++i) {
+            snprintf(cmd, sizeof(cmd), "sleep %d", i);
+            int slot = tasks_append(bench_command(cmd), URGENCY_LOW, REGION_ANY, 24, 1730822400 + i);
+            lsn = journal_append(JOURNAL_SUBMIT, slot);
+            pending_push(slot);
+        }
+        pthread_mutex_unlock(&tasks_lock);
+        journal_commit(lsn, 1);
+    }
+    t_submit += now_sec() - t0;
+    journal_shutdown();
+    bench_forget();
+    double t1 = now_sec();
+    if (journal_recover() != 0 || task_live != BENCH_QUEUE_MAX || pending_total() != BENCH_QUEUE_MAX) {
+        fprintf(stderr, "recovery mismatch: %d live, %d pending\n", task_live, pending_total()); exit(1);
+    }
+    double t2 = now_sec();
+    printf("%d durable submits: %.1f ns/task; recovery: %.0f ms (%.1f ns/task)\n",
+           BENCH_QUEUE_MAX, t_submit * 1e9 / BENCH_QUEUE_MAX, (t2 - t1) * 1e3, (t2 - t1) * 1e9 / BENCH_QUEUE_MAX);
+    printf("snapshot of %d tasks: %.0f ms, tasks_lock held %.1f ms\n", BENCH_QUEUE_MAX - BENCH_QUEUE_MAX / 10,
+           t_compact * 1e3, held / 1e3);
+    bench_journal_unlink(prefix);
+}
+
+/* GET /tasks over BENCH_QUEUE_MAX tasks: the tasks_lock holds of one view build, then
+ * 100-task pages (JSON rendered) served from the view, unfiltered and by state + urgency */
+static void bench_task_view(void) {
+    char cmd[64];
+    bench_forget();
+    pthread_mutex_lock(&tasks_lock);
+    for (int i = 0; i < BENCH_QUEUE_MAX; ++i) {
+        snprintf(cmd, sizeof(cmd), "sleep %d", i);
+        int slot = tasks_append(bench_command(cmd), (Urgency)(i % URGENCY_COUNT), REGION_ANY, 24, 1730822400 + i);
+        if (i % 10 == 0) task_hot[slot].state = TASK_RUNNING;
+    }
+    pthread_mutex_unlock(&tasks_lock);
+    char **limbo = NULL;
+    int limbo_count = 0;
+    uint64_t held0 = histograms[HIST_LOCK_HOLD].sum_us, holds0 = histograms[HIST_LOCK_HOLD].count;
+    double t0 = now_sec();
+    TaskView *v = task_view_build(&limbo, &limbo_count);
+    double t1 = now_sec();
+    task_view_publish(v, limbo, limbo_count);
+    printf("view of %d tasks: built in %.1f ms, tasks_lock held %.1f ms in %llu holds\n", v->count, (t1 - t0) * 1e3,
+           (histograms[HIST_LOCK_HOLD].sum_us - held0) / 1e3, (unsigned long long)(histograms[HIST_LOCK_HOLD].count - holds0));
+    unsigned masks[2][2] = { { 7, 7 }, { 1u << VIEW_PENDING, 1u << URGENCY_LOW } };
+    const char *names[2] = { "all", "pending+low" };
+    for (int m = 0; m < 2; ++m) {
+        int requests = 0;
+        uint32_t cursor = 0;
+        t0 = now_sec();
+        for (; requests < 20000; ++requests) {
+            uint64_t epoch;
+            const TaskView *cur = task_view_enter(&epoch);
+            struct json_object *page = task_view_page(cur, masks[m][0], masks[m][1], cursor, 100);
+            char *body = strdup(json_object_to_json_string_ext(page, JSON_C_TO_STRING_PLAIN));
+            struct json_object *next;
+            cursor = json_object_object_get_ex(page, "next_cursor", &next) && next ? (uint32_t)json_object_get_int64(next) : 0;
+            task_view_exit(epoch);
+            json_object_put(page);
+            free(body);
+        }
+        printf("%-12s %.0f pages/sec (100 tasks each, single thread)\n", names[m], requests / (now_sec() - t0));
+    }
+    tasks_lock_acquire();
+    char **rest = task_limbo;
+    int rest_count = task_limbo_count;
+    task_limbo = NULL; task_limbo_count = task_limbo_capacity = 0;
+    task_view_active = 0;
+    tasks_lock_release();
+    task_view_publish(NULL, rest, rest_count);
+    while (task_view_retired) task_view_reclaim();
+}
+
+/* submit throughput by submitter thread count, one task per request: every thread applying
+ * its own request under tasks_lock (the old ingest path) against the MPSC hand-off, where
+ * a consumer thread standing in for the scheduler loop drains and acknowledges batches.
+ * submit does not wait for the ack, so like an HTTP worker with suspended connections each
+ * thread keeps BENCH_INGEST_WINDOW requests in flight and reuses one once it is acked. */
+#define BENCH_INGEST_REQUESTS 200000
+#define BENCH_INGEST_WINDOW 32
+
+typedef struct IngestWorker { int thread; int count; int use_queue; } IngestWorker;
+static int bench_ingest_stop;
+
+static void bench_ingest_wait(struct http_cb_ctx *ctx) {
+    while (__atomic_load_n(&ctx->state, __ATOMIC_ACQUIRE) != INGEST_ACKED) sched_yield();
+    http_cb_ctx_free(ctx);
+}
+
+static void *bench_ingest_worker(void *arg) {
+    IngestWorker *w = arg;
+    struct http_cb_ctx *window[BENCH_INGEST_WINDOW] = { NULL };
+    char cmd[64];
+    for (int i = 0; i < w->count; ++i) {
+        struct http_cb_ctx *ctx = http_cb_ctx_new();
+        snprintf(cmd, sizeof(cmd), "submit %d-%d", w->thread, i);
+        staged_list_push(ctx, &ctx->staged[URGENCY_HIGH], (StagedTask){ command_compile(cmd, strlen(cmd), &ctx->arena, NULL), URGENCY_HIGH, 1, 1730822400, REGION_ANY });
+        if (w->use_queue) {
+            struct http_cb_ctx **slot = &window[i % BENCH_INGEST_WINDOW];
+            if (*slot) bench_ingest_wait(*slot);
+            *slot = ctx;
+            ingest_submit(ctx);
+            continue;
+        }
+        uint64_t lsn = 0;
+        CarbonSnapshot carbon[MAX_REGIONS] = {{0}};
+        pthread_mutex_lock(&tasks_lock);
+        ingest_apply(ctx, carbon, &lsn);
+        pthread_mutex_unlock(&tasks_lock);
+        http_cb_ctx_free(ctx);
+    }
+    for (int i = 0; i < BENCH_INGEST_WINDOW; ++i) if (window[i]) bench_ingest_wait(window[i]);
+    return NULL;
+}
+
+static void *bench_ingest_consumer(void *arg) {
+    while (!__atomic_load_n(&bench_ingest_stop, __ATOMIC_RELAXED)) {
+        struct epoll_event ev;
+        uint64_t n;
+        if (epoll_wait(sched_epoll_fd, &ev, 1, 100) > 0 && read(ev.data.fd, &n, sizeof(n)) < 0) break;
+        ingest_drain(0);
+    }
+    return NULL;
+}
+
+static double bench_ingest_rate(int threads, int use_queue) {
+    pthread_t tids[16], consumer;
+    IngestWorker workers[16];
+    bench_forget();
+    bench_ingest_stop = 0;
+    if (use_queue) pthread_create(&consumer, NULL, bench_ingest_consumer, NULL);
+    double t0 = now_sec();
+    for (int i = 0; i < threads; ++i) {
+        workers[i] = (IngestWorker){ i, BENCH_INGEST_REQUESTS / threads, use_queue };
+        pthread_create(&tids[i], NULL, bench_ingest_worker, &workers[i]);
+    }
+    for (int i = 0; i < threads; ++i) pthread_join(tids[i], NULL);
+    double rate = (BENCH_INGEST_REQUESTS / threads) * threads / (now_sec() - t0);
+    if (use_queue) { __atomic_store_n(&bench_ingest_stop, 1, __ATOMIC_RELAXED); sched_wake(); pthread_join(consumer, NULL); }
+    if (task_live != BENCH_INGEST_REQUESTS / threads * threads) { fprintf(stderr, "ingest lost tasks: %d\n", task_live); exit(1); }
+    return rate;
+}
+
+/* heap allocations for one POST /add_tasks body of n tasks, fed in 32 KiB pieces as MHD
+ * hands it over: the HTTP thread's part (parse into the request arena) and the scheduler
+ * loop's (apply to the queue, copying commands into task strings). the same batch is
+ * applied and retired once first, so queue growth is not counted. */
+static void bench_request_allocs(void) {
+    static const int sizes[] = { 1, 10, 100, 10000, 100000 };
+    printf("%-10s %-12s %-12s %-12s %-10s\n", "tasks", "allocs/req", "parse/task", "apply/task", "arena_kb");
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k) {
+        int n = sizes[k];
+        size_t len = 0;
+        char *body = NULL;
+        FILE *f = open_memstream(&body, &len);
+        for (int i = 0; i < n; ++i)
+            fprintf(f, "%c{\"command\":\"python3 job.py --input '/data/part %d.csv' --threads 4\",\"urgency\":\"high\",\"deadline_hours\":12}", i ? ',' : '[', i);
+        fputs("]", f);
+        fclose(f);
+        uint64_t counts[3];
+        size_t arena_bytes = 0;
+        for (int round = 0; round < 2; ++round) {
+            bench_reset();
+            bench_pending_clear();
+            counts[0] = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+            struct http_cb_ctx *ctx = http_cb_ctx_new();
+            for (size_t off = 0; off < len; off += 32768) ingest_feed(ctx, body + off, len - off < 32768 ? len - off : 32768);
+            if (ctx->state != INGEST_DONE) { fprintf(stderr, "request rejected: %s\n", ctx->error); exit(1); }
+            counts[1] = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+            ctx->ingest_next = NULL;
+            ingest_head = ctx;
+            ingest_drain(0);
+            counts[2] = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+            arena_bytes = 0;
+            for (ArenaBlock *b = ctx->arena.head; b; b = b->next) arena_bytes += b->size;
+            http_cb_ctx_free(ctx);
+        }
+        if (task_live != n) { fprintf(stderr, "request lost tasks: %d of %d\n", task_live, n); exit(1); }
+        printf("%-10d %-12llu %-12.2f %-12.2f %-10zu\n", n, (unsigned long long)(counts[2] - counts[0]),
+               (double)(counts[1] - counts[0]) / n, (double)(counts[2] - counts[1]) / n, arena_bytes / 1024);
+        free(body);
+    }
+    bench_forget();
+}
+
+static void bench_ingest(void) {
+    if (sched_init() != 0) { fprintf(stderr, "sched_init failed\n"); exit(1); }
+    printf("%-10s %-14s %-14s %-10s\n", "threads", "mutex req/s", "queue req/s", "req/drain");
+    for (int threads = 1; threads <= 16; threads *= 2) {
+        double locked = bench_ingest_rate(threads, 0);
+        uint64_t drains0 = counters[COUNTER_INGEST_DRAINS], reqs0 = counters[COUNTER_INGEST_REQUESTS];
+        double queued = bench_ingest_rate(threads, 1);
+        printf("%-10d %-14.0f %-14.0f %-10.1f\n", threads, locked, queued,
+               (double)(counters[COUNTER_INGEST_REQUESTS] - reqs0) / (double)(counters[COUNTER_INGEST_DRAINS] - drains0));
+    }
+    bench_forget();
+}
+
+int main(void) {
+    carbon_regions_init();
+    printf("== launch rate vs heap size ==\n");
+    bench_launch();
+    printf("== task churn (append, pid lookup, retire) ==\n");
+    bench_churn();
+    bench_reset();
+    printf("== pending heaps (push / pop in due order) ==\n");
+    bench_pending();
+    printf("== launch batch and completion handling ==\n");
+    bench_completion();
+    printf("== dedup ingest (batch %d) ==\n", BENCH_BATCH);
+    bench_dedup_ingest();
+    printf("== hot-field scan ==\n");
+    bench_hot_scan();
+    printf("== ingest (one task per request) ==\n");
+    bench_ingest();
+    printf("== heap allocations per request ==\n");
+    bench_request_allocs();
+    printf("== task view (GET /tasks) ==\n");
+    bench_task_view();
+    printf("== journal (group commit per %d, recovery of snapshot + tail) ==\n", BENCH_BATCH);
+    bench_journal();
+    return 0;
+}
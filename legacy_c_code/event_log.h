@@ -0,0 +1,57 @@
+/* On-disk layout of the daemon's binary event log. main_code.c writes it; loadgen.c and
+ * live_dashboard.py read it back, so a change here is a format change for all three.
+ *
+ * fixed 64-byte records are appended to EVENT_LOG_PREFIX.<seq>.bin segments behind a 64-byte
+ * header, so a segment can be mmapped as an array. EVENT_LOG_PREFIX.idx gets one
+ * EventIndexEntry per segment, letting readers locate any global record number and tail
+ * from their last offset instead of re-reading. */
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdint.h>
+
+#define EVENT_LOG_PREFIX "/tmp/scheduler_events"
+#define EVENT_LOG_MAGIC "GSEVLOG1"
+#define EVENT_LOG_VERSION 1
+
+enum { EVENT_SUBMITTED = 1, EVENT_DEFERRED, EVENT_LAUNCHED, EVENT_COMPLETED, EVENT_INTENSITY, EVENT_SUSPENDED, EVENT_RESUMED };
+
+typedef struct EventRecord {
+    int64_t ts_ms;
+    uint8_t type;
+    uint8_t urgency;
+    uint8_t level;        /* CarbonLevel, for EVENT_INTENSITY */
+    uint8_t delayed;
+    int32_t pid;
+    uint32_t slot;
+    uint32_t gen;
+    union {
+        int32_t forecast; /* gCO2/kWh, for EVENT_INTENSITY */
+        int32_t status;   /* for EVENT_COMPLETED: the wait status, or -errno if the spawn failed */
+    };
+    float delay_sec;      /* submit -> completion, for EVENT_COMPLETED */
+    uint64_t key_hash;    /* task_key_hash(command, submitted_at) */
+    char command[24];     /* truncated, NUL padded; the region name for EVENT_INTENSITY */
+} EventRecord;
+
+typedef struct EventSegmentHeader {
+    char magic[8];        /* EVENT_LOG_MAGIC */
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t segment_seq;
+    uint64_t first_record; /* global number of the segment's first record */
+    int64_t created_ms;
+    char reserved[24];
+} EventSegmentHeader;
+
+typedef struct EventIndexEntry {
+    uint64_t segment_seq;
+    uint64_t first_record;
+    int64_t first_ts_ms;
+    uint64_t reserved;
+} EventIndexEntry;
+
+_Static_assert(sizeof(EventRecord) == 64, "EventRecord must stay 64 bytes");
+_Static_assert(sizeof(EventSegmentHeader) == 64, "EventSegmentHeader must stay 64 bytes");
+
+#endif
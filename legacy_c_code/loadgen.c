@@ -0,0 +1,411 @@
+/* Load generator for the daemon's POST /add_tasks.
+ *
+ * Each connection is one keep-alive socket with one request in flight. Closed loop (the
+ * default) sends the next request as soon as the previous one is acknowledged; open loop
+ * (--rate) sends on a fixed schedule and measures each ack from the time the request was due,
+ * so a stalled daemon shows up as latency instead of as fewer samples. Afterwards the binary
+ * event log is read back to pair every task's EVENT_SUBMITTED with its EVENT_LAUNCHED.
+ * With --daemon-pid, the daemon's resident memory and thread count are sampled from /proc
+ * during the run, so the HTTP modes can be compared on requests/s and memory in one go.
+ *
+ * Build (needs only event_log.h from the daemon):
+ *   gcc -O2 -o loadgen loadgen.c -lpthread
+ * Run:
+ *   ./loadgen --connections 8 --batch 10 --duration 10
+ *   ./loadgen --connections 8 --batch 10 --rate 2000 --urgency low --deadline 1
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "event_log.h"
+
+#define LOADGEN_DEFAULT_PORT 8080
+#define LOADGEN_RESPONSE_MAX 4096
+#define LOADGEN_DEFAULT_CONNECTIONS 4
+#define LOADGEN_DEFAULT_DURATION 10
+#define LOADGEN_DEFAULT_SETTLE_MS 2000
+#define LOADGEN_SAMPLE_MS 100
+
+typedef struct LoadConn {
+    pthread_t thread;
+    int id;
+    int fd;
+    uint64_t ok;
+    uint64_t failed;
+    uint32_t *latency_us;
+    size_t latency_count;
+    size_t latency_capacity;
+} LoadConn;
+
+static unsigned loadgen_connections = LOADGEN_DEFAULT_CONNECTIONS;
+static unsigned loadgen_batch = 1;
+static unsigned loadgen_rate = 0;          /* requests/s over all connections; 0: closed loop */
+static unsigned loadgen_duration = LOADGEN_DEFAULT_DURATION;
+static unsigned loadgen_port = LOADGEN_DEFAULT_PORT;
+static unsigned loadgen_deadline = 1;
+static unsigned loadgen_settle_ms = LOADGEN_DEFAULT_SETTLE_MS;
+static const char *loadgen_urgency = "high";
+static const char *loadgen_events = EVENT_LOG_PREFIX;
+static unsigned loadgen_daemon_pid = 0;    /* daemon to sample from /proc; 0: none */
+static char loadgen_tag[24];               /* command prefix that marks this run's tasks */
+static uint64_t loadgen_start_ns;
+static uint64_t loadgen_end_ns;
+
+typedef struct DaemonUsage {
+    unsigned samples;
+    unsigned long rss_kb_first;
+    unsigned long rss_kb_peak;
+    unsigned long threads_peak;
+} DaemonUsage;
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t at) {
+    struct timespec ts = { (time_t)(at / 1000000000), (long)(at % 1000000000) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+static int loadgen_connect(void) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)loadgen_port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) { close(fd); return -1; }
+    return fd;
+}
+
+static int loadgen_send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t w = send(fd, buf, len, MSG_NOSIGNAL);
+        if (w < 0) { if (errno == EINTR) continue; return -1; }
+        buf += w; len -= (size_t)w;
+    }
+    return 0;
+}
+
+/* read one response; returns its status code, or -1 if the connection broke. *keep is
+ * cleared when the server asked to close. */
+static int loadgen_read_response(int fd, int *keep) {
+    char buf[LOADGEN_RESPONSE_MAX + 1];
+    size_t have = 0;
+    char *eoh;
+    for (;;) {
+        ssize_t r = recv(fd, buf + have, LOADGEN_RESPONSE_MAX - have, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        have += (size_t)r;
+        buf[have] = 0;
+        if ((eoh = strstr(buf, "\r\n\r\n"))) break;
+        if (have == LOADGEN_RESPONSE_MAX) return -1;
+    }
+    int status;
+    if (sscanf(buf, "HTTP/1.%*d %d", &status) != 1) return -1;
+    const char *cl = strcasestr(buf, "\r\nContent-Length:");
+    size_t body = cl && cl < eoh ? strtoul(cl + 17, NULL, 10) : 0;
+    const char *conn = strcasestr(buf, "\r\nConnection: close");
+    *keep = !(conn && conn < eoh);
+    size_t got = have - (size_t)(eoh + 4 - buf);
+    while (got < body) {   /* bodies are short status lines; drain without keeping them */
+        ssize_t r = recv(fd, buf, sizeof(buf) - 1 < body - got ? sizeof(buf) - 1 : body - got, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        got += (size_t)r;
+    }
+    return status;
+}
+
+/* request seq of connection c, head and body in one buffer so it goes out in one send */
+#define LOADGEN_TASK_MAX 128   /* one task object in the request body */
+
+static size_t loadgen_request(char **buf, size_t *cap, char *body, const LoadConn *c, uint64_t seq) {
+    size_t body_cap = 2 + (size_t)loadgen_batch * LOADGEN_TASK_MAX;
+    size_t n = 0;
+    body[n++] = '[';
+    for (unsigned j = 0; j < loadgen_batch; ++j)
+        n += (size_t)snprintf(body + n, body_cap - n,
+                              "%s{\"command\":\"true %s%d.%llu.%u\",\"urgency\":\"%s\",\"deadline_hours\":%u}",
+                              j ? "," : "", loadgen_tag, c->id, (unsigned long long)seq, j, loadgen_urgency,
+                              loadgen_deadline);
+    body[n++] = ']';
+    if (*cap < n + 160) { *cap = n + 160; *buf = realloc(*buf, *cap); }
+    size_t len = (size_t)snprintf(*buf, *cap, "POST /add_tasks HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                                  "Content-Type: application/json\r\nContent-Length: %zu\r\n\r\n", n);
+    memcpy(*buf + len, body, n);
+    return len + n;
+}
+
+static void loadgen_record(LoadConn *c, uint64_t us) {
+    if (c->latency_count == c->latency_capacity) {
+        c->latency_capacity = c->latency_capacity ? c->latency_capacity * 2 : 4096;
+        c->latency_us = realloc(c->latency_us, sizeof(uint32_t) * c->latency_capacity);
+    }
+    c->latency_us[c->latency_count++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static void *loadgen_worker(void *arg) {
+    LoadConn *c = arg;
+    char *req = NULL, *body = malloc(2 + (size_t)loadgen_batch * LOADGEN_TASK_MAX);
+    size_t cap = 0;
+    uint64_t interval = loadgen_rate ? (uint64_t)loadgen_connections * 1000000000 / loadgen_rate : 0;
+    uint64_t due = loadgen_start_ns + interval * (uint64_t)c->id / loadgen_connections;   /* staggered */
+    c->fd = -1;
+    for (uint64_t seq = 0;; ++seq) {
+        if (interval) { if (due >= loadgen_end_ns) break; sleep_until_ns(due); }
+        else if ((due = mono_ns()) >= loadgen_end_ns) break;
+        if (c->fd < 0 && (c->fd = loadgen_connect()) < 0) {
+            c->failed++;
+            sleep_until_ns(mono_ns() + 100000000);
+            due += interval;
+            continue;
+        }
+        size_t len = loadgen_request(&req, &cap, body, c, seq);
+        int keep = 0;
+        int status = loadgen_send_all(c->fd, req, len) == 0 ? loadgen_read_response(c->fd, &keep) : -1;
+        uint64_t done = mono_ns();
+        if (status == 200) { c->ok++; loadgen_record(c, (done - due) / 1000); }
+        else c->failed++;
+        if (!keep) { close(c->fd); c->fd = -1; }
+        due += interval;
+    }
+    if (c->fd >= 0) close(c->fd);
+    free(req);
+    free(body);
+    return NULL;
+}
+
+/* Reads VmRSS and Threads from /proc/<pid>/status. */
+static int daemon_status(unsigned pid, unsigned long *rss_kb, unsigned long *threads) {
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%u/status", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int found = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmRSS: %lu", rss_kb) == 1) found |= 1;
+        else if (sscanf(line, "Threads: %lu", threads) == 1) found |= 2;
+    }
+    fclose(f);
+    return found == 3 ? 0 : -1;
+}
+
+static void *loadgen_sampler(void *arg) {
+    DaemonUsage *u = arg;
+    for (uint64_t at = loadgen_start_ns; at < loadgen_end_ns; at += (uint64_t)LOADGEN_SAMPLE_MS * 1000000) {
+        sleep_until_ns(at);
+        unsigned long rss_kb, threads;
+        if (daemon_status(loadgen_daemon_pid, &rss_kb, &threads) != 0) break;
+        if (u->samples++ == 0) u->rss_kb_first = rss_kb;
+        if (rss_kb > u->rss_kb_peak) u->rss_kb_peak = rss_kb;
+        if (threads > u->threads_peak) u->threads_peak = threads;
+    }
+    return NULL;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t n, double p) {
+    size_t i = (size_t)(p * (double)n);
+    return sorted[i < n ? i : n - 1];
+}
+
+static void print_percentiles(const char *what, uint32_t *v, size_t n) {
+    if (n == 0) { printf("%-18s no samples\n", what); return; }
+    qsort(v, n, sizeof(*v), compare_u32);
+    printf("%-18s p50 %-8u p90 %-8u p99 %-8u p99.9 %-8u max %u\n", what, percentile(v, n, 0.5),
+           percentile(v, n, 0.9), percentile(v, n, 0.99), percentile(v, n, 0.999), v[n - 1]);
+}
+
+typedef struct LoadEvent { uint64_t key; int64_t ts_ms; } LoadEvent;
+
+static int compare_event(const void *a, const void *b) {
+    uint64_t x = ((const LoadEvent *)a)->key, y = ((const LoadEvent *)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+static void event_push(LoadEvent **v, size_t *n, size_t *cap, const EventRecord *r) {
+    if (*n == *cap) { *cap = *cap ? *cap * 2 : 4096; *v = realloc(*v, sizeof(LoadEvent) * *cap); }
+    (*v)[(*n)++] = (LoadEvent){ (uint64_t)r->gen << 32 | r->slot, r->ts_ms };
+}
+
+/* submit -> launch for this run's tasks, from every event segment still listed in the index */
+static void loadgen_launch_latency(int64_t since_ms, uint64_t tasks) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s.idx", loadgen_events);
+    FILE *idx = fopen(path, "rb");
+    if (!idx) { printf("submit->launch     no event log at %s\n", path); return; }
+    LoadEvent *submits = NULL, *launches = NULL;
+    size_t nsub = 0, capsub = 0, nlaunch = 0, caplaunch = 0, nspawn_failed = 0;
+    size_t tag_len = strlen(loadgen_tag) + 5;   /* "true " + tag */
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "true %s", loadgen_tag);
+    EventIndexEntry e;
+    while (fread(&e, sizeof(e), 1, idx) == 1) {
+        snprintf(path, sizeof(path), "%s.%llu.bin", loadgen_events, (unsigned long long)e.segment_seq);
+        FILE *seg = fopen(path, "rb");
+        if (!seg) continue;   /* rotated away */
+        EventRecord r;
+        fseek(seg, sizeof(EventSegmentHeader), SEEK_SET);
+        while (fread(&r, sizeof(r), 1, seg) == 1) {
+            if (r.ts_ms < since_ms || strncmp(r.command, prefix, tag_len) != 0) continue;
+            if (r.type == EVENT_SUBMITTED) event_push(&submits, &nsub, &capsub, &r);
+            else if (r.type == EVENT_LAUNCHED) event_push(&launches, &nlaunch, &caplaunch, &r);
+            else if (r.type == EVENT_COMPLETED && r.status < 0) nspawn_failed++;   /* never started */
+        }
+        fclose(seg);
+    }
+    fclose(idx);
+    qsort(submits, nsub, sizeof(*submits), compare_event);
+    uint32_t *delay = malloc(sizeof(uint32_t) * (nlaunch + 1));
+    size_t n = 0;
+    for (size_t i = 0; i < nlaunch; ++i) {
+        LoadEvent *s = bsearch(&launches[i], submits, nsub, sizeof(*submits), compare_event);
+        if (s) delay[n++] = (uint32_t)(launches[i].ts_ms - s->ts_ms);
+    }
+    printf("events             %zu of %llu tasks submitted, %zu launched, %zu failed to spawn\n", nsub,
+           (unsigned long long)tasks, n, nspawn_failed);
+    print_percentiles("submit->launch ms", delay, n);
+    free(delay);
+    free(submits);
+    free(launches);
+}
+
+static void loadgen_usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--connections N] [--batch N] [--rate N] [--duration SEC] [--port N]\n"
+            "          [--urgency high|medium|low] [--deadline HOURS] [--events PREFIX] [--settle-ms N]\n"
+            "          [--daemon-pid PID]\n"
+            "  --connections  keep-alive connections, one request in flight each (default %d)\n"
+            "  --batch        tasks per request (default 1)\n"
+            "  --rate         open loop: requests/s over all connections (default: closed loop)\n"
+            "  --duration     seconds to send for (default %d)\n"
+            "  --port         daemon port on 127.0.0.1 (default %d)\n"
+            "  --urgency      urgency of every task (default high)\n"
+            "  --deadline     deadline_hours of every task (default 1)\n"
+            "  --events       binary event log prefix to read launches from (default %s)\n"
+            "  --settle-ms    wait before reading the event log (default %d)\n"
+            "  --daemon-pid   sample this process's RSS and thread count during the run\n",
+            prog, LOADGEN_DEFAULT_CONNECTIONS, LOADGEN_DEFAULT_DURATION, LOADGEN_DEFAULT_PORT, EVENT_LOG_PREFIX,
+            LOADGEN_DEFAULT_SETTLE_MS);
+}
+
+static int parse_positive(const char *arg, unsigned *out) {
+    char *end;
+    long v = strtol(arg, &end, 10);
+    if (*arg == 0 || *end != 0 || v <= 0) return -1;
+    *out = (unsigned)v;
+    return 0;
+}
+
+static int parse_urgency(const char *arg) {
+    return strcmp(arg, "high") == 0 || strcmp(arg, "medium") == 0 || strcmp(arg, "low") == 0 ? 0 : -1;
+}
+
+static int loadgen_parse_args(int argc, char *argv[]) {
+    static const struct option opts[] = {
+        { "connections", required_argument, NULL, 'c' },
+        { "batch", required_argument, NULL, 'b' },
+        { "rate", required_argument, NULL, 'r' },
+        { "duration", required_argument, NULL, 'd' },
+        { "port", required_argument, NULL, 'p' },
+        { "urgency", required_argument, NULL, 'u' },
+        { "deadline", required_argument, NULL, 'D' },
+        { "events", required_argument, NULL, 'e' },
+        { "settle-ms", required_argument, NULL, 's' },
+        { "daemon-pid", required_argument, NULL, 'P' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", opts, NULL)) != -1) {
+        switch (opt) {
+        case 'c': if (parse_positive(optarg, &loadgen_connections) != 0) return -1; break;
+        case 'b': if (parse_positive(optarg, &loadgen_batch) != 0) return -1; break;
+        case 'r': if (parse_positive(optarg, &loadgen_rate) != 0) return -1; break;
+        case 'd': if (parse_positive(optarg, &loadgen_duration) != 0) return -1; break;
+        case 'p': if (parse_positive(optarg, &loadgen_port) != 0 || loadgen_port > 65535) return -1; break;
+        case 'u': if (parse_urgency(optarg) != 0) return -1; loadgen_urgency = optarg; break;
+        case 'D': if (parse_positive(optarg, &loadgen_deadline) != 0) return -1; break;
+        case 'e': if (*optarg == 0) return -1; loadgen_events = optarg; break;
+        case 's': if (parse_positive(optarg, &loadgen_settle_ms) != 0) return -1; break;
+        case 'P': if (parse_positive(optarg, &loadgen_daemon_pid) != 0) return -1; break;
+        default: return -1;
+        }
+    }
+    return optind == argc ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    if (loadgen_parse_args(argc, argv) != 0) { loadgen_usage(argv[0]); return 2; }
+    snprintf(loadgen_tag, sizeof(loadgen_tag), "lg%d.", (int)getpid());
+    LoadConn *conns = calloc(loadgen_connections, sizeof(LoadConn));
+    int64_t since_ms = now_ms();
+    loadgen_start_ns = mono_ns();
+    loadgen_end_ns = loadgen_start_ns + (uint64_t)loadgen_duration * 1000000000;
+    DaemonUsage usage = { 0 };
+    pthread_t sampler;
+    if (loadgen_daemon_pid) pthread_create(&sampler, NULL, loadgen_sampler, &usage);
+    for (unsigned i = 0; i < loadgen_connections; ++i) {
+        conns[i].id = (int)i;
+        pthread_create(&conns[i].thread, NULL, loadgen_worker, &conns[i]);
+    }
+    uint64_t ok = 0, failed = 0;
+    size_t samples = 0;
+    for (unsigned i = 0; i < loadgen_connections; ++i) {
+        pthread_join(conns[i].thread, NULL);
+        ok += conns[i].ok;
+        failed += conns[i].failed;
+        samples += conns[i].latency_count;
+    }
+    double secs = (double)(mono_ns() - loadgen_start_ns) / 1e9;
+    if (loadgen_daemon_pid) pthread_join(sampler, NULL);
+    uint32_t *latency = malloc(sizeof(uint32_t) * (samples + 1));
+    samples = 0;
+    for (unsigned i = 0; i < loadgen_connections; ++i) {
+        memcpy(latency + samples, conns[i].latency_us, sizeof(uint32_t) * conns[i].latency_count);
+        samples += conns[i].latency_count;
+        free(conns[i].latency_us);
+    }
+
+    if (loadgen_rate) printf("open loop, %u req/s target", loadgen_rate);
+    else printf("closed loop");
+    printf(", %u connections, %u tasks/request, %s urgency, %.1f s\n", loadgen_connections, loadgen_batch,
+           loadgen_urgency, secs);
+    printf("requests           %llu ok, %llu failed (%.0f req/s, %.0f tasks/s)\n", (unsigned long long)ok,
+           (unsigned long long)failed, (double)ok / secs, (double)ok * loadgen_batch / secs);
+    print_percentiles("ack latency us", latency, samples);
+    if (loadgen_daemon_pid && usage.samples == 0)
+        printf("daemon             cannot read /proc/%u/status\n", loadgen_daemon_pid);
+    else if (loadgen_daemon_pid)
+        printf("daemon             rss %.1f MiB at start, %.1f MiB peak; %lu threads peak (%u samples)\n",
+               usage.rss_kb_first / 1024.0, usage.rss_kb_peak / 1024.0, usage.threads_peak, usage.samples);
+    free(latency);
+    free(conns);
+    sleep_until_ns(mono_ns() + (uint64_t)loadgen_settle_ms * 1000000);
+    loadgen_launch_latency(since_ms, ok * loadgen_batch);
+    return failed ? 1 : 0;
+}
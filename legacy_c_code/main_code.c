@@ -2,6 +2,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -10,315 +13,3431 @@
 #include <curl/curl.h>
 #include <json-c/json.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <spawn.h>
 #include <signal.h>
 #include <errno.h>
 #include <pthread.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <libgen.h>
 #include <microhttpd.h>
+#include "event_log.h"
 
 #define LOG_FILE "/tmp/scheduler.log"
 #define PID_FILE "/var/run/green_scheduler.pid"
-#define CARBON_API_URL "http://127.0.0.1:5000/intensity"
+#define CARBON_API_BASE "http://127.0.0.1:5000"   /* the default region's intensity API */
+#define CARBON_CURRENT_PATH "/intensity"
+#define CARBON_FORECAST_PATH "/intensity/%s/fw48h"
+#define CARBON_API_TIMEOUT_MS 10000  /* per request; a round's requests run concurrently */
+#define MAX_REGIONS 16
+#define REGION_ANY 255               /* task runs in whichever region is greenest when it is due */
+#define FORECAST_REFRESH 1800        /* seconds between forecast series fetches */
+#define FORECAST_MAX_SLOTS 512
 #define HTTP_PORT 8080
-#define POLL_INTERVAL 90
+#define HTTP_DEFAULT_WORKERS 4
+#define HTTP_DEFAULT_MAX_CONNS 1024
+#define HTTP_DEFAULT_IDLE_TIMEOUT 30
+#define POLL_INTERVAL 90             /* carbon refresh period while tasks are live */
+#define CARBON_MIN_REFRESH 5
 #define MAX_TASKS_INCREMENT 32
+#define DEFAULT_MAX_RUNNING_HIGH 64
+#define DEFAULT_MAX_RUNNING_MEDIUM 32
+#define DEFAULT_MAX_RUNNING_LOW 16
+#define REAP_FALLBACK_MS 100         /* waitpid polling period for children without a pidfd */
+#define CARBON_CLEAR_SAMPLES 2       /* consecutive non-high readings before deferral lifts */
+#define CPU_WATTS_PER_CORE 15.0      /* assumed draw of one busy core, for gCO2 estimates */
+#define LOG_RING_SLOTS 8192          /* power of two */
+#define LOG_RECORD_TEXT 240
+#define LOG_BATCH_BYTES 65536
+#define EVENT_SEGMENT_RECORDS (1 << 20)  /* 64 MiB segments */
+#define EVENT_SEGMENTS_KEEP 8
+#define JOURNAL_PREFIX "/tmp/scheduler_journal"
+#define JOURNAL_COMPACT_BYTES (16 << 20)  /* smallest journal segment worth folding into a snapshot */
 
-typedef struct Task {
-    char *command;
-    char *urgency;
+/* scheduling clock and executor: the daemon schedules on the wall clock and runs real
+ * children. simulate_scheduler.c defines SCHEDULER_SIMULATED and supplies a virtual clock
+ * and a modeled executor (sim_now, sim_spawn, sim_watch, sim_kill) before including this file. */
+#ifdef SCHEDULER_SIMULATED
+#define clock_now sim_now
+#define exec_spawn sim_spawn
+#define exec_watch sim_watch
+#define exec_kill sim_kill
+#else
+#define clock_now() time(NULL)
+#define exec_spawn spawn_command
+#define exec_watch reap_watch
+#define exec_kill kill
+#endif
+
+/* daemon lifecycle entry points: main() calls them all, while a harness built with
+ * SCHEDULER_NO_MAIN calls only the ones it needs */
+#ifdef SCHEDULER_NO_MAIN
+#define SCHEDULER_ENTRY __attribute__((unused))
+#else
+#define SCHEDULER_ENTRY
+#endif
+
+/* urgency and carbon level are interned once at ingest / fetch; hot paths compare small ints */
+typedef enum Urgency { URGENCY_HIGH, URGENCY_MEDIUM, URGENCY_LOW, URGENCY_COUNT } Urgency;
+typedef enum CarbonLevel { CARBON_UNKNOWN, CARBON_LOW, CARBON_MODERATE, CARBON_HIGH, CARBON_VERY_HIGH } CarbonLevel;
+
+enum { TASK_FREE, TASK_PENDING, TASK_LAUNCHING, TASK_RUNNING, TASK_SUSPENDED };
+
+/* a task is split by access pattern: the fields the scheduler touches on every decision
+ * live in a dense 16-byte TaskHot array (four per cache line), everything else in TaskCold.
+ * both arrays are indexed by the same slot. */
+typedef struct TaskHot {
+    uint8_t state;
+    uint8_t urgency;
+    uint8_t delayed;
+    uint8_t region;           /* region it was started in (or is pinned to, while pending) */
+    pid_t pid;
+    time_t deadline;
+} TaskHot;
+
+typedef struct TaskCold {
+    char *command;            /* text, followed in the same allocation by argv (command_compile) */
+    char **argv;
+    time_t submitted_at;
     int deadline_hours;
+    int region;               /* as submitted: a region index or REGION_ANY */
+    time_t started_at;
+    double odometer_at_start; /* carbon_odometer() at launch or at the last resume */
+    double odometer_run;      /* odometer distance covered in earlier running stretches */
+    time_t suspended_at;
+    double suspended_sec;
+    uint64_t queued_us;       /* mono_us() when queued, for queue-wait metrics */
+    uint64_t started_us;      /* mono_us() at launch */
+    uint32_t gen;   /* bumped every time the slot is retired */
+    int next_free;  /* free-list link while the slot is unused */
+    int active_pos; /* index in task_active while running or suspended */
+} TaskCold;
+
+struct MemoryStruct { char *memory; size_t size; };
+
+/* the task arrays are a slot arena: completed tasks are retired onto a free list and their
+ * slots reused, so their size tracks the peak number of live tasks, not lifetime submissions */
+static TaskHot *task_hot = NULL;
+static TaskCold *task_cold = NULL;
+static int task_count = 0;      /* slots ever handed out (high-water mark) */
+static int task_live = 0;
+static int task_capacity = 0;
+static int task_free_head = -1;
+static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* read snapshots of the queue (GET /tasks) point at task command strings. while one may be
+ * live, retired commands go to a limbo list instead of free() and are released only once no
+ * reader can still see them. task_version counts transitions, so an unchanged queue is not
+ * copied again. all guarded by tasks_lock. */
+static int task_view_active = 0;
+static int journal_compacting = 0;   /* a snapshot is reading commands outside tasks_lock */
+static char **task_limbo = NULL;
+static int task_limbo_count = 0;
+static int task_limbo_capacity = 0;
+static unsigned task_version = 0;
+
+static int completed_tasks = 0;
+static double total_delay_seconds = 0.0;
+
+/* resource use of completed tasks per urgency class, from wait4() rusage; guarded by tasks_lock */
+typedef struct UsageTotals { int tasks; int failed; double cpu_sec; double gco2; long max_rss_kb; double suspended_sec; } UsageTotals;
+static UsageTotals usage_totals[URGENCY_COUNT];
+
+/* admission control: children launching or running per urgency class, and the cap on each */
+static int task_running[URGENCY_COUNT] = {0};
+static int task_suspended[URGENCY_COUNT] = {0};   /* the stopped subset of task_running */
+static unsigned max_running[URGENCY_COUNT] = { DEFAULT_MAX_RUNNING_HIGH, DEFAULT_MAX_RUNNING_MEDIUM, DEFAULT_MAX_RUNNING_LOW };
+
+/* slots of running and suspended tasks, densely packed in no particular order, so the
+ * preemption pass visits only them rather than every slot; guarded by tasks_lock */
+static int *task_active = NULL;
+static int task_active_count = 0;
+static int task_active_capacity = 0;
+
+/* preemption: running non-urgent tasks are stopped while the level is at or above this
+ * (CARBON_UNKNOWN = disabled, the default) */
+static CarbonLevel preempt_level = CARBON_UNKNOWN;
+
+static FILE *logfp_global = NULL;
+static int running_foreground = 0;
+
+/* HTTP server mode: "thread" is libmicrohttpd thread-per-connection over select(), "epoll"
+ * is a fixed pool of epoll worker threads sharing the listen socket with keep-alive */
+enum { HTTP_MODE_THREAD, HTTP_MODE_EPOLL };
+static int http_mode = HTTP_MODE_THREAD;
+static unsigned http_workers = HTTP_DEFAULT_WORKERS;
+static unsigned http_max_conns = HTTP_DEFAULT_MAX_CONNS;
+static unsigned http_idle_timeout = HTTP_DEFAULT_IDLE_TIMEOUT;
+static volatile sig_atomic_t exit_requested = 0;
+static volatile sig_atomic_t exit_signal = 0;
+
+/* asynchronous logger: callers format their line into a slot of a bounded lock-free MPSC
+ * ring (Vyukov sequence-numbered cells) and return; log_writer prefixes the cached
+ * per-second timestamp and writes whole batches with one write(). lines longer than a slot
+ * spill to the heap. when the ring is full the record is dropped and counted. */
+/* binary event log (layout in event_log.h): events travel through the same ring as text
+ * lines and are written by log_writer; the text log stays as the human-readable copy. */
+
+enum { LOG_KIND_TEXT, LOG_KIND_EVENT };
+
+typedef struct LogRecord {
+    size_t seq;
+    time_t ts;
+    int kind;
+    char *spill;                    /* heap copy for lines that do not fit in text */
+    union { char text[LOG_RECORD_TEXT]; EventRecord event; };
+} LogRecord;
+
+static LogRecord log_ring[LOG_RING_SLOTS];
+static size_t log_enqueue_pos = 0;
+static size_t log_dequeue_pos = 0;   /* owned by log_writer */
+static unsigned long log_dropped = 0;
+static int log_writer_idle = 0;
+static int log_wake_fd = -1;
+static int log_stop = 0;
+static pthread_t log_thread;
+
+static SCHEDULER_ENTRY void log_init(void) {
+    for (size_t i = 0; i < LOG_RING_SLOTS; ++i) log_ring[i].seq = i;
+    log_wake_fd = eventfd(0, EFD_CLOEXEC);
+}
+
+/* claim a free ring cell for a producer; NULL (and a drop) if the ring is full */
+static LogRecord *log_claim(size_t *out_pos) {
+    size_t pos = __atomic_load_n(&log_enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        LogRecord *rec = &log_ring[pos & (LOG_RING_SLOTS - 1)];
+        size_t seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&log_enqueue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { *out_pos = pos; return rec; }
+        } else if (dif < 0) {
+            __atomic_fetch_add(&log_dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        } else pos = __atomic_load_n(&log_enqueue_pos, __ATOMIC_RELAXED);
+    }
+}
+
+/* hand a filled cell to log_writer, waking it if it is parked */
+static void log_publish(LogRecord *rec, size_t pos) {
+    __atomic_store_n(&rec->seq, pos + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&log_writer_idle, 0, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+        if (write(log_wake_fd, &one, sizeof(one)) < 0) { /* writer polls again on its next wake */ }
+    }
+}
+
+__attribute__((format(printf, 1, 2)))
+static void log_msg(const char *fmt, ...) {
+    size_t pos;
+    LogRecord *rec = log_claim(&pos);
+    if (!rec) return;
+    rec->kind = LOG_KIND_TEXT;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(rec->text, sizeof(rec->text), fmt, ap);
+    va_end(ap);
+    rec->spill = NULL;
+    if (n >= (int)sizeof(rec->text) && (rec->spill = malloc(n + 1)) != NULL) {
+        va_start(ap, fmt);
+        vsnprintf(rec->spill, n + 1, fmt, ap);
+        va_end(ap);
+    }
+    rec->ts = time(NULL);
+    log_publish(rec, pos);
+}
+
+static void log_event(const EventRecord *ev) {
+    size_t pos;
+    LogRecord *rec = log_claim(&pos);
+    if (!rec) return;
+    rec->kind = LOG_KIND_EVENT;
+    rec->spill = NULL;
+    rec->event = *ev;
+    rec->ts = (time_t)(ev->ts_ms / 1000);
+    log_publish(rec, pos);
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* metrics: relaxed atomic counters and log2-bucketed latency histograms that any thread
+ * updates without a lock; GET /metrics renders them in the Prometheus text format. a value
+ * of v microseconds lands in bucket bit_length(v), i.e. bucket i counts values below 2^i us;
+ * the last bucket takes everything from 2^(METRIC_BUCKETS-1) us (about 4.8 hours) up. */
+#define METRIC_BUCKETS 36
+
+typedef struct Histogram { uint64_t buckets[METRIC_BUCKETS]; uint64_t count; uint64_t sum_us; } Histogram;
+
+enum { HIST_SUBMIT_ACK, HIST_QUEUE_WAIT, HIST_SPAWN, HIST_RUN, HIST_LOCK_WAIT, HIST_LOCK_HOLD, HIST_CARBON_API,
+       HIST_JOURNAL_SYNC, HIST_COUNT };
+static const char *const histogram_names[HIST_COUNT][2] = {
+    { "scheduler_submit_ack_seconds", "POST /add_tasks from first byte to the reply, journal sync included" },
+    { "scheduler_queue_wait_seconds", "time from submission to launch" },
+    { "scheduler_spawn_seconds", "posix_spawn of one child" },
+    { "scheduler_task_run_seconds", "time from launch to exit, suspended time included" },
+    { "scheduler_tasks_lock_wait_seconds", "time spent waiting for tasks_lock" },
+    { "scheduler_tasks_lock_hold_seconds", "time tasks_lock was held" },
+    { "scheduler_carbon_api_seconds", "carbon intensity API requests" },
+    { "scheduler_journal_sync_seconds", "fdatasync of one journal group commit" },
+};
+static Histogram histograms[HIST_COUNT];
+
+enum { COUNTER_SUBMITTED, COUNTER_DUPLICATES, COUNTER_LAUNCHED, COUNTER_LAUNCH_FAILED, COUNTER_COMPLETED,
+       COUNTER_FAILED, COUNTER_CARBON_ERRORS, COUNTER_INGEST_REQUESTS, COUNTER_INGEST_DRAINS, COUNTER_COUNT };
+static const char *const counter_names[COUNTER_COUNT][2] = {
+    { "scheduler_tasks_submitted_total", "tasks accepted into the queue" },
+    { "scheduler_tasks_duplicate_total", "submitted tasks dropped as duplicates" },
+    { "scheduler_tasks_launched_total", "children started" },
+    { "scheduler_launch_failures_total", "spawn attempts that failed" },
+    { "scheduler_tasks_completed_total", "children reaped" },
+    { "scheduler_tasks_failed_total", "children that exited non-zero or on a signal" },
+    { "scheduler_carbon_api_errors_total", "carbon API requests that failed" },
+    { "scheduler_ingest_requests_total", "POST /add_tasks requests handed to the scheduler loop" },
+    { "scheduler_ingest_drains_total", "ingest queue drains (requests per drain = batch size)" },
+};
+static uint64_t counters[COUNTER_COUNT];
+
+static uint64_t mono_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void counter_add(int c, uint64_t n) { __atomic_fetch_add(&counters[c], n, __ATOMIC_RELAXED); }
+
+/* queue depth per urgency class and state, mirrored where the counts under tasks_lock change
+ * so GET /metrics reads them without taking the lock */
+enum { DEPTH_PENDING, DEPTH_RUNNING, DEPTH_SUSPENDED, DEPTH_COUNT };
+static int depth_gauges[URGENCY_COUNT][DEPTH_COUNT];
+
+static void depth_add(int urgency, int state, int n) { __atomic_fetch_add(&depth_gauges[urgency][state], n, __ATOMIC_RELAXED); }
+
+static void histogram_observe(int h, uint64_t us) {
+    Histogram *x = &histograms[h];
+    int b = us ? 64 - __builtin_clzll(us) : 0;
+    if (b >= METRIC_BUCKETS) b = METRIC_BUCKETS - 1;
+    __atomic_fetch_add(&x->buckets[b], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&x->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&x->sum_us, us, __ATOMIC_RELAXED);
+}
+
+/* tasks_lock with wait and hold times; an uncontended acquire records a zero wait untimed */
+static uint64_t tasks_lock_acquired_us = 0;   /* guarded by tasks_lock */
+
+static void tasks_lock_acquire(void) {
+    uint64_t waited = 0;
+    if (pthread_mutex_trylock(&tasks_lock) != 0) {
+        uint64_t t0 = mono_us();
+        pthread_mutex_lock(&tasks_lock);
+        tasks_lock_acquired_us = mono_us();
+        waited = tasks_lock_acquired_us - t0;
+    } else tasks_lock_acquired_us = mono_us();
+    histogram_observe(HIST_LOCK_WAIT, waited);
+}
+
+static void tasks_lock_release(void) {
+    histogram_observe(HIST_LOCK_HOLD, mono_us() - tasks_lock_acquired_us);
+    pthread_mutex_unlock(&tasks_lock);
+}
+
+static LogRecord *log_peek(void) {
+    LogRecord *rec = &log_ring[log_dequeue_pos & (LOG_RING_SLOTS - 1)];
+    return __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) == log_dequeue_pos + 1 ? rec : NULL;
+}
+
+static void log_release(LogRecord *rec) {
+    free(rec->spill);
+    __atomic_store_n(&rec->seq, log_dequeue_pos + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+    log_dequeue_pos++;
+}
+
+static void log_write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t w = write(fd, buf, len);
+        if (w < 0) { if (errno == EINTR) continue; return; }
+        buf += w; len -= (size_t)w;
+    }
+}
+
+/* event segment state, owned by log_writer */
+static int event_fd = -1;
+static uint64_t event_segment_seq = 0;
+static uint64_t event_next_record = 0;      /* global number of the next record */
+static uint64_t event_segment_records = 0;  /* records in the open segment */
+
+static void event_segment_path(char *buf, size_t len, uint64_t seq) {
+    snprintf(buf, len, "%s.%llu.bin", EVENT_LOG_PREFIX, (unsigned long long)seq);
+}
+
+static void event_segment_open(uint64_t seq, int64_t first_ts_ms) {
+    char path[256];
+    if (event_fd >= 0) close(event_fd);
+    event_segment_path(path, sizeof(path), seq);
+    event_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (event_fd < 0) return;
+    EventSegmentHeader hdr = {0};
+    memcpy(hdr.magic, EVENT_LOG_MAGIC, 8);
+    hdr.version = EVENT_LOG_VERSION;
+    hdr.record_size = sizeof(EventRecord);
+    hdr.segment_seq = seq;
+    hdr.first_record = event_next_record;
+    hdr.created_ms = first_ts_ms;
+    log_write_all(event_fd, (const char *)&hdr, sizeof(hdr));
+    event_segment_seq = seq;
+    event_segment_records = 0;
+    /* index entry is appended only once the segment exists, so readers never see a dangling entry */
+    int idx = open(EVENT_LOG_PREFIX ".idx", O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (idx >= 0) {
+        EventIndexEntry e = { seq, event_next_record, first_ts_ms, 0 };
+        log_write_all(idx, (const char *)&e, sizeof(e));
+        close(idx);
+    }
+    if (seq >= EVENT_SEGMENTS_KEEP) {
+        event_segment_path(path, sizeof(path), seq - EVENT_SEGMENTS_KEEP);
+        unlink(path);
+    }
+}
+
+/* continue numbering after whatever a previous run left in the index */
+static void event_log_start(void) {
+    int idx = open(EVENT_LOG_PREFIX ".idx", O_RDONLY | O_CLOEXEC);
+    uint64_t seq = 0;
+    if (idx >= 0) {
+        EventIndexEntry last;
+        off_t end = lseek(idx, 0, SEEK_END);
+        if (end >= (off_t)sizeof(last) && pread(idx, &last, sizeof(last), end - end % sizeof(last) - sizeof(last)) == sizeof(last)) {
+            char path[256];
+            struct stat st;
+            event_segment_path(path, sizeof(path), last.segment_seq);
+            uint64_t n = (stat(path, &st) == 0 && st.st_size > (off_t)sizeof(EventSegmentHeader))
+                         ? (uint64_t)(st.st_size - sizeof(EventSegmentHeader)) / sizeof(EventRecord) : 0;
+            event_next_record = last.first_record + n;
+            seq = last.segment_seq + 1;
+        }
+        close(idx);
+    }
+    event_segment_open(seq, now_ms());
+}
+
+static void event_log_write(const EventRecord *batch, size_t n) {
+    while (n > 0 && event_fd >= 0) {
+        if (event_segment_records == EVENT_SEGMENT_RECORDS) event_segment_open(event_segment_seq + 1, batch[0].ts_ms);
+        if (event_fd < 0) break;
+        size_t room = EVENT_SEGMENT_RECORDS - event_segment_records;
+        size_t k = n < room ? n : room;
+        log_write_all(event_fd, (const char *)batch, k * sizeof(EventRecord));
+        event_segment_records += k;
+        event_next_record += k;
+        batch += k; n -= k;
+    }
+}
+
+/* drain everything currently queued; returns number of records written */
+static size_t log_drain(int fd, char *batch, EventRecord *events) {
+    static time_t cached_sec = -1;
+    static char cached_prefix[32];
+    size_t used = 0, written = 0, nevents = 0;
+    LogRecord *rec;
+    while ((rec = log_peek()) != NULL) {
+        written++;
+        if (rec->kind == LOG_KIND_EVENT) {
+            events[nevents++] = rec->event;
+            log_release(rec);
+            if (nevents == LOG_BATCH_BYTES / sizeof(EventRecord)) { event_log_write(events, nevents); nevents = 0; }
+            continue;
+        }
+        if (rec->ts != cached_sec) {
+            struct tm t;
+            char timebuf[24];
+            localtime_r(&rec->ts, &t);
+            strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", &t);
+            snprintf(cached_prefix, sizeof(cached_prefix), "[%s] ", timebuf);
+            cached_sec = rec->ts;
+        }
+        const char *text = rec->spill ? rec->spill : rec->text;
+        size_t plen = strlen(cached_prefix), tlen = strlen(text);
+        if (used + plen + tlen > LOG_BATCH_BYTES) { log_write_all(fd, batch, used); used = 0; }
+        if (plen + tlen > LOG_BATCH_BYTES) {
+            log_write_all(fd, cached_prefix, plen);
+            log_write_all(fd, text, tlen);
+        } else {
+            memcpy(batch + used, cached_prefix, plen); used += plen;
+            memcpy(batch + used, text, tlen); used += tlen;
+        }
+        log_release(rec);
+    }
+    if (used > 0) log_write_all(fd, batch, used);
+    if (nevents > 0) event_log_write(events, nevents);
+    return written;
+}
+
+static void* log_writer(void *arg) {
+    int fd = fileno(logfp_global);
+    char *batch = malloc(LOG_BATCH_BYTES);
+    EventRecord *events = malloc(LOG_BATCH_BYTES);
+    unsigned long reported_drops = 0;
+    event_log_start();
+    if (event_fd < 0) log_msg("[ERROR] Cannot open binary event log %s.*.bin: %s\n", EVENT_LOG_PREFIX, strerror(errno));
+    time_t reported_at = 0;
+    for (;;) {
+        log_drain(fd, batch, events);
+        unsigned long drops = __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+        if (drops != reported_drops && time(NULL) != reported_at) {
+            log_msg("[WARN] Logger overloaded: %lu records dropped so far\n", drops);
+            reported_drops = drops;
+            reported_at = time(NULL);
+            continue;
+        }
+        if (__atomic_load_n(&log_stop, __ATOMIC_ACQUIRE)) break;
+        __atomic_store_n(&log_writer_idle, 1, __ATOMIC_SEQ_CST);
+        if (log_peek()) { __atomic_store_n(&log_writer_idle, 0, __ATOMIC_RELAXED); continue; }
+        uint64_t v;
+        if (read(log_wake_fd, &v, sizeof(v)) < 0 && errno != EINTR) break;
+    }
+    log_drain(fd, batch, events);
+    free(batch);
+    free(events);
+    if (event_fd >= 0) close(event_fd);
+    return NULL;
+}
+
+static SCHEDULER_ENTRY int log_start(void) {
+    fflush(logfp_global);
+    return pthread_create(&log_thread, NULL, log_writer, NULL);
+}
+
+/* flush everything queued and stop the writer; log_msg must not be called afterwards */
+static SCHEDULER_ENTRY void log_shutdown(void) {
+    __atomic_store_n(&log_stop, 1, __ATOMIC_RELEASE);
+    uint64_t one = 1;
+    if (write(log_wake_fd, &one, sizeof(one)) < 0) { /* writer still sees log_stop on its next pass */ }
+    pthread_join(log_thread, NULL);
+    close(log_wake_fd);
+}
+
+/* curl write callback */
+static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+    struct MemoryStruct *mem = (struct MemoryStruct *)userp;
+    char *ptr = realloc(mem->memory, mem->size + realsize + 1);
+    if (!ptr) return 0;
+    mem->memory = ptr;
+    memcpy(&(mem->memory[mem->size]), contents, realsize);
+    mem->size += realsize;
+    mem->memory[mem->size] = 0;
+    return realsize;
+}
+
+/* carbon intensity snapshot: fetched by carbon_refresher and published through a seqlock,
+ * so the HTTP handler and the scheduling loop read it without touching the network */
+typedef struct CarbonSnapshot {
+    CarbonLevel level;
+    int forecast;         /* gCO2/kWh, -1 if unknown */
+    time_t valid_from;    /* validity window reported by the API (data[0].from/to) */
+    time_t valid_to;
+    time_t fetched_at;
+    int deferring;        /* hysteresis-filtered high-carbon state the scheduler acts on */
+    int preempting;       /* same filter against preempt_level */
+    int rate;             /* forecast, or the last known one while it is unknown */
+    double odometer;      /* integral of rate over time up to fetched_at (gCO2/kWh * s) */
+} CarbonSnapshot;
+
+/* forecast plan: the fw48h series as slots, and for every slot k the index of the lowest
+ * forecast among slots 0..k (earliest on ties). a task that must start before its deadline D
+ * is planned at best[last slot starting before D]; that index never moves earlier as D
+ * grows, so the deadline-ordered pending heaps are ordered by planned start as well and a
+ * scheduling pass still only looks at each heap's top. a new forecast just rebuilds this
+ * O(slots) table: nothing is recomputed per task. swapped under tasks_lock. */
+typedef struct ForecastSlot { time_t from; time_t to; int forecast; int best; } ForecastSlot;
+typedef struct ForecastPlan { int count; time_t fetched_at; ForecastSlot slots[]; } ForecastPlan;
+
+/* carbon regions: every --region is an intensity API of its own, with its own reading, TTL,
+ * hysteresis and forecast plan. the refresher fetches all of them at once through one curl
+ * multi handle, whose connection cache keeps each API's connection open between rounds.
+ * without --region there is a single region "default" on CARBON_API_BASE. the list is fixed
+ * before any thread starts. */
+typedef struct CarbonRegion {
+    char name[24];                /* NUL terminated; also fits EventRecord.command */
+    char base[256];               /* API base URL; CARBON_CURRENT_PATH / CARBON_FORECAST_PATH are appended */
+    unsigned ttl;                 /* seconds a reading is trusted without a refetch */
+    CarbonSnapshot current;       /* published through seq */
+    unsigned seq;                 /* odd while a publish is in progress */
+    int clear_streak;             /* carbon_gate hysteresis, refresher only */
+    int preempt_clear_streak;
+    time_t attempted_at;          /* last reading fetch started, refresher only */
+    time_t forecast_fetched_at;   /* refresher only */
+    ForecastPlan *plan;           /* guarded by tasks_lock */
+    char env[48];                 /* "CARBON_REGION=<name>" */
+    char **envp;                  /* environ plus env, for children started in this region */
+    CURL *easy[2];                /* refresher only: reading and forecast transfers, reused */
+    struct MemoryStruct body[2];
+} CarbonRegion;
+
+_Static_assert(sizeof(((CarbonRegion *)0)->name) == sizeof(((EventRecord *)0)->command), "region names go in EVENT_INTENSITY records");
+
+enum { CARBON_FETCH_CURRENT, CARBON_FETCH_FORECAST };
+
+static CarbonRegion carbon_regions[MAX_REGIONS] = { { .name = "default", .base = CARBON_API_BASE, .ttl = POLL_INTERVAL } };
+static int carbon_region_count = 1;
+static int carbon_regions_configured = 0;   /* the first --region replaces "default" */
+static pthread_mutex_t carbon_wait_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t carbon_wait_cond = PTHREAD_COND_INITIALIZER;
+
+static void carbon_publish(int region, const CarbonSnapshot *snap) {
+    CarbonRegion *r = &carbon_regions[region];
+    __atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&r->current, snap, sizeof(*snap));
+    __atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_RELEASE);
+}
+
+static void carbon_snapshot_read(int region, CarbonSnapshot *out) {
+    const CarbonRegion *r = &carbon_regions[region];
+    unsigned before, after;
+    do {
+        before = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+        memcpy(out, &r->current, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&r->seq, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+}
+
+/* every region's snapshot, indexed by region */
+static void carbon_snapshot_read_all(CarbonSnapshot out[MAX_REGIONS]) {
+    for (int i = 0; i < carbon_region_count; ++i) carbon_snapshot_read(i, &out[i]);
+}
+
+static int carbon_is_high(const CarbonSnapshot *snap) { return snap->deferring; }
+
+/* a snapshot too old to schedule on: its window has closed and a refresh is overdue */
+static int carbon_is_stale(int region, const CarbonSnapshot *snap, time_t now) {
+    return snap->valid_to <= now && now - snap->fetched_at >= (time_t)carbon_regions[region].ttl;
+}
+
+/* when a region's reading is due again: when the API validity window closes or its TTL
+ * elapses, whichever is first, but never sooner than CARBON_MIN_REFRESH after the last
+ * fetch or attempt (so a dead API is not hammered while its last window is still open) */
+static time_t carbon_next_fetch(int region, const CarbonSnapshot *cur) {
+    const CarbonRegion *r = &carbon_regions[region];
+    time_t next = cur->fetched_at + r->ttl;
+    if (cur->valid_to > cur->fetched_at && cur->valid_to < next) next = cur->valid_to;
+    if (next < cur->fetched_at + CARBON_MIN_REFRESH) next = cur->fetched_at + CARBON_MIN_REFRESH;
+    if (next < r->attempted_at + CARBON_MIN_REFRESH) next = r->attempted_at + CARBON_MIN_REFRESH;
+    return next;
+}
+
+static const char *region_name(int region) { return region == REGION_ANY ? "any" : carbon_regions[region].name; }
+
+/* region index by name: REGION_ANY for NULL or "any", -1 if no such region */
+static int region_lookup(const char *name) {
+    if (!name || strcmp(name, "any") == 0) return REGION_ANY;
+    for (int i = 0; i < carbon_region_count; ++i)
+        if (strcmp(carbon_regions[i].name, name) == 0) return i;
+    return -1;
+}
+
+/* build each region's child environment: environ with CARBON_REGION set to its name */
+static SCHEDULER_ENTRY void carbon_regions_init(void) {
+    int n = 0;
+    while (environ[n]) n++;
+    for (int i = 0; i < carbon_region_count; ++i) {
+        CarbonRegion *r = &carbon_regions[i];
+        snprintf(r->env, sizeof(r->env), "CARBON_REGION=%s", r->name);
+        r->envp = malloc(sizeof(char *) * (n + 2));
+        int k = 0;
+        for (int j = 0; j < n; ++j)
+            if (strncmp(environ[j], "CARBON_REGION=", 14) != 0) r->envp[k++] = environ[j];
+        r->envp[k++] = r->env;
+        r->envp[k] = NULL;
+    }
+}
+
+/* intensity odometer at time t: the difference between two readings divided by the elapsed
+ * time is the average intensity over that interval, which is what a task is charged */
+static double carbon_odometer(const CarbonSnapshot *snap, time_t t) {
+    return snap->odometer + (t > snap->fetched_at ? (double)snap->rate * (t - snap->fetched_at) : 0.0);
+}
+
+static CarbonLevel parse_carbon_level(const char *index) {
+    if (!index) return CARBON_UNKNOWN;
+    if (strcmp(index, "low") == 0 || strcmp(index, "very low") == 0) return CARBON_LOW;
+    if (strcmp(index, "moderate") == 0) return CARBON_MODERATE;
+    if (strcmp(index, "high") == 0) return CARBON_HIGH;
+    if (strcmp(index, "very high") == 0) return CARBON_VERY_HIGH;
+    return CARBON_UNKNOWN;
+}
+
+static Urgency parse_urgency(const char *u) {
+    if (u && strcmp(u, "high") == 0) return URGENCY_HIGH;
+    if (u && strcmp(u, "medium") == 0) return URGENCY_MEDIUM;
+    return URGENCY_LOW;
+}
+
+static const char *urgency_name(int u) {
+    static const char *names[URGENCY_COUNT] = { "high", "medium", "low" };
+    return names[u];
+}
+
+/* "2024-11-05T12:30Z" -> epoch seconds, 0 if missing or malformed */
+static time_t parse_api_time(struct json_object *obj) {
+    const char *str = obj ? json_object_get_string(obj) : NULL;
+    struct tm t = {0};
+    if (!str || !strptime(str, "%Y-%m-%dT%H:%M", &t)) return 0;
+    return timegm(&t);
+}
+
+/* read the current intensity out of an /intensity reply; 0 on success */
+static int carbon_parse_current(int region, struct json_object *root, CarbonSnapshot *out) {
+    struct json_object *data_array = NULL;
+    if (!json_object_object_get_ex(root, "data", &data_array)) return -1;
+    struct json_object *first_entry = json_object_array_get_idx(data_array, 0);
+    if (!first_entry) return -1;
+    struct json_object *intensity_obj = NULL;
+    if (!json_object_object_get_ex(first_entry, "intensity", &intensity_obj)) return -1;
+    struct json_object *index_obj = NULL, *forecast_obj = NULL, *from_obj = NULL, *to_obj = NULL;
+    json_object_object_get_ex(intensity_obj, "index", &index_obj);
+    json_object_object_get_ex(intensity_obj, "forecast", &forecast_obj);
+    json_object_object_get_ex(first_entry, "from", &from_obj);
+    json_object_object_get_ex(first_entry, "to", &to_obj);
+    const char *index = index_obj ? json_object_get_string(index_obj) : NULL;
+    int forecast = forecast_obj ? json_object_get_int(forecast_obj) : -1;
+    log_msg("[INFO] Carbon Intensity Level: %s | Forecast: %d gCO2/kWh | Region: %s\n",
+            index ? index : "unknown", forecast, carbon_regions[region].name);
+    memset(out, 0, sizeof(*out));
+    out->level = parse_carbon_level(index);
+    out->forecast = forecast;
+    out->valid_from = parse_api_time(from_obj);
+    out->valid_to = parse_api_time(to_obj);
+    out->fetched_at = clock_now();
+    EventRecord ev = {0};
+    ev.ts_ms = now_ms();
+    ev.type = EVENT_INTENSITY;
+    ev.level = (uint8_t)out->level;
+    ev.forecast = forecast;
+    memcpy(ev.command, carbon_regions[region].name, sizeof(ev.command));
+    log_event(&ev);
+    return 0;
+}
+
+/* deferral hysteresis: a high reading defers at once, but deferral only lifts after
+ * CARBON_CLEAR_SAMPLES consecutive readings below high, so a single-sample dip does not
+ * release the backlog. preemption is filtered the same way against preempt_level. only the
+ * refresher (one writer at a time) touches a region's streaks. */
+static void carbon_gate(CarbonRegion *r, CarbonSnapshot *snap, const CarbonSnapshot *prev) {
+    if (snap->level >= CARBON_HIGH) r->clear_streak = 0;
+    else r->clear_streak++;
+    snap->deferring = snap->level >= CARBON_HIGH || (prev->deferring && r->clear_streak < CARBON_CLEAR_SAMPLES);
+    if (snap->deferring && !prev->deferring) log_msg("[INFO] Carbon high: deferring non-urgent tasks | Region: %s\n", r->name);
+    else if (!snap->deferring && prev->deferring)
+        log_msg("[INFO] Carbon below high for %d readings: releasing deferred tasks | Region: %s\n", r->clear_streak, r->name);
+    if (preempt_level == CARBON_UNKNOWN) return;
+    if (snap->level >= preempt_level) r->preempt_clear_streak = 0;
+    else r->preempt_clear_streak++;
+    snap->preempting = snap->level >= preempt_level || (prev->preempting && r->preempt_clear_streak < CARBON_CLEAR_SAMPLES);
+    if (snap->preempting && !prev->preempting)
+        log_msg("[INFO] Carbon at preemption level: suspending running non-urgent tasks | Region: %s\n", r->name);
+    else if (!snap->preempting && prev->preempting)
+        log_msg("[INFO] Carbon below preemption level for %d readings: resuming suspended tasks | Region: %s\n",
+                r->preempt_clear_streak, r->name);
+}
+
+/* run a new reading through the gate and publish it, carrying the odometer forward */
+static void carbon_apply(int region, CarbonSnapshot *snap) {
+    CarbonSnapshot cur;
+    carbon_snapshot_read(region, &cur);
+    carbon_gate(&carbon_regions[region], snap, &cur);
+    snap->rate = snap->forecast >= 0 ? snap->forecast : cur.rate;
+    snap->odometer = carbon_odometer(&cur, snap->fetched_at);
+    carbon_publish(region, snap);
+}
+
+/* publish a fetched reading; after a failed fetch (snap NULL) keep the last snapshot while
+ * its window is still open and otherwise publish "unknown" (which, as before, counts as not
+ * high) */
+static void carbon_update(int region, CarbonSnapshot *snap) {
+    CarbonSnapshot cur, unknown;
+    if (!snap) {
+        time_t now = clock_now();
+        carbon_snapshot_read(region, &cur);
+        if (cur.valid_to > now || now - cur.fetched_at < (time_t)carbon_regions[region].ttl) return;
+        memset(&unknown, 0, sizeof(unknown));
+        unknown.forecast = -1;
+        unknown.fetched_at = now;
+        snap = &unknown;
+    }
+    carbon_apply(region, snap);
+}
+
+/* start of the greenest slot that begins before deadline; 0 if none does */
+static time_t forecast_plan_start(const ForecastPlan *plan, time_t deadline) {
+    int lo = 0, hi = plan->count;   /* first slot with from >= deadline */
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (plan->slots[mid].from < deadline) lo = mid + 1; else hi = mid;
+    }
+    return lo == 0 ? 0 : plan->slots[plan->slots[lo - 1].best].from;
+}
+
+/* the region's installed plan, unless its horizon has already passed */
+static const ForecastPlan *forecast_plan_live(int region, time_t now) {
+    const ForecastPlan *plan = carbon_regions[region].plan;
+    return (plan && plan->slots[plan->count - 1].to > now) ? plan : NULL;
+}
+
+/* append a slot to a plan being built; slots out of order or empty are skipped */
+static void forecast_plan_add(ForecastPlan *plan, time_t from, time_t to, int forecast) {
+    if (to <= from || (plan->count > 0 && from < plan->slots[plan->count - 1].from)) return;
+    ForecastSlot *slot = &plan->slots[plan->count];
+    slot->from = from;
+    slot->to = to;
+    slot->forecast = forecast;
+    int prev = plan->count > 0 ? plan->slots[plan->count - 1].best : -1;
+    slot->best = (prev >= 0 && plan->slots[prev].forecast <= forecast) ? prev : plan->count;
+    plan->count++;
+}
+
+/* swap in a built plan for a region (taking ownership); -1 and freed if it has no slots */
+static int forecast_install(int region, ForecastPlan *plan) {
+    if (plan->count == 0) { free(plan); return -1; }
+    struct tm tm;
+    const ForecastSlot *green = &plan->slots[plan->slots[plan->count - 1].best];
+    char at[32], until[32];
+    strftime(at, sizeof(at), "%Y-%m-%d %H:%M", localtime_r(&green->from, &tm));
+    strftime(until, sizeof(until), "%Y-%m-%d %H:%M", localtime_r(&plan->slots[plan->count - 1].to, &tm));
+    log_msg("[INFO] Forecast: %d slots until %s | greenest %d gCO2/kWh at %s | Region: %s\n",
+            plan->count, until, green->forecast, at, carbon_regions[region].name);
+    tasks_lock_acquire();
+    ForecastPlan *old = carbon_regions[region].plan;
+    carbon_regions[region].plan = plan;
+    tasks_lock_release();
+    free(old);
+    return 0;
+}
+
+/* build a plan out of a fw48h reply; NULL if it has no data array */
+static ForecastPlan *forecast_parse(struct json_object *root, time_t fetched_at) {
+    struct json_object *data = NULL;
+    if (!json_object_object_get_ex(root, "data", &data) || !json_object_is_type(data, json_type_array)) return NULL;
+    size_t n = json_object_array_length(data);
+    if (n > FORECAST_MAX_SLOTS) n = FORECAST_MAX_SLOTS;
+    ForecastPlan *plan = malloc(sizeof(ForecastPlan) + n * sizeof(ForecastSlot));
+    plan->count = 0;
+    plan->fetched_at = fetched_at;
+    for (size_t i = 0; i < n; ++i) {
+        struct json_object *entry = json_object_array_get_idx(data, i);
+        struct json_object *intensity = NULL, *forecast = NULL, *from_obj = NULL, *to_obj = NULL;
+        if (!json_object_object_get_ex(entry, "intensity", &intensity) ||
+            !json_object_object_get_ex(intensity, "forecast", &forecast)) continue;
+        json_object_object_get_ex(entry, "from", &from_obj);
+        json_object_object_get_ex(entry, "to", &to_obj);
+        forecast_plan_add(plan, parse_api_time(from_obj), parse_api_time(to_obj), json_object_get_int(forecast));
+    }
+    return plan;
+}
+
+/* queue a GET of a region's reading or forecast on the multi handle, reusing the region's
+ * easy handle (and through the multi handle's cache, its connection) */
+static void carbon_fetch_start(CURLM *multi, int region, int kind, time_t now) {
+    CarbonRegion *r = &carbon_regions[region];
+    char url[512];
+    if (kind == CARBON_FETCH_CURRENT) {
+        snprintf(url, sizeof(url), "%s" CARBON_CURRENT_PATH, r->base);
+        r->attempted_at = now;
+    } else {
+        struct tm tm;
+        char from[32];
+        strftime(from, sizeof(from), "%Y-%m-%dT%H:%MZ", gmtime_r(&now, &tm));
+        int n = snprintf(url, sizeof(url), "%s", r->base);
+        snprintf(url + n, sizeof(url) - n, CARBON_FORECAST_PATH, from);
+        r->forecast_fetched_at = now;
+    }
+    if (!r->easy[kind] && !(r->easy[kind] = curl_easy_init())) return;
+    CURL *curl = r->easy[kind];
+    r->body[kind].size = 0;
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&r->body[kind]);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)CARBON_API_TIMEOUT_MS);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)(intptr_t)(region * 2 + kind));
+    curl_multi_add_handle(multi, curl);
+}
+
+/* a finished transfer: record its latency and hand the parsed reply to its region */
+static void carbon_fetch_done(CURL *curl, CURLcode res) {
+    char *id = NULL;
+    curl_off_t us = 0;
+    curl_easy_getinfo(curl, CURLINFO_PRIVATE, &id);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &us);
+    histogram_observe(HIST_CARBON_API, (uint64_t)us);
+    int region = (int)(intptr_t)id / 2, kind = (int)(intptr_t)id % 2;
+    CarbonRegion *r = &carbon_regions[region];
+    struct json_object *root = NULL;
+    if (res != CURLE_OK) {
+        counter_add(COUNTER_CARBON_ERRORS, 1);
+        log_msg("[ERROR] Carbon API request failed: %s | Region: %s\n", curl_easy_strerror(res), r->name);
+    } else if (r->body[kind].size > 0) root = json_tokener_parse(r->body[kind].memory);
+    if (kind == CARBON_FETCH_CURRENT) {
+        CarbonSnapshot snap;
+        carbon_update(region, root && carbon_parse_current(region, root, &snap) == 0 ? &snap : NULL);
+    } else if (root) {
+        ForecastPlan *plan = forecast_parse(root, r->forecast_fetched_at);
+        if (plan) forecast_install(region, plan);
+    }
+    if (root) json_object_put(root);
+}
+
+/* one refresh round: start every reading whose region is due (carbon_next_fetch) and every
+ * forecast older than FORECAST_REFRESH, all at once, and wait for them together, so a slow
+ * or dead API costs one timeout per round rather than one per region. once exit is
+ * requested (and the poll woken with curl_multi_wakeup) the transfers still running are
+ * abandoned. */
+static void carbon_fetch_round(CURLM *multi) {
+    time_t now = clock_now();
+    for (int i = 0; i < carbon_region_count; ++i) {
+        CarbonSnapshot cur;
+        carbon_snapshot_read(i, &cur);
+        if (now >= carbon_next_fetch(i, &cur)) carbon_fetch_start(multi, i, CARBON_FETCH_CURRENT, now);
+        if (now - carbon_regions[i].forecast_fetched_at >= FORECAST_REFRESH) carbon_fetch_start(multi, i, CARBON_FETCH_FORECAST, now);
+    }
+    int running;
+    do {
+        if (curl_multi_perform(multi, &running) != CURLM_OK) break;
+        CURLMsg *msg;
+        int left;
+        while ((msg = curl_multi_info_read(multi, &left)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            CURL *curl = msg->easy_handle;
+            CURLcode res = msg->data.result;
+            curl_multi_remove_handle(multi, curl);
+            carbon_fetch_done(curl, res);
+        }
+        if (running > 0 && !exit_requested) curl_multi_poll(multi, NULL, 0, 1000, NULL);
+    } while (running > 0 && !exit_requested);
+    for (int i = 0; i < carbon_region_count; ++i)   /* no-op for handles already removed */
+        for (int k = 0; k < 2; ++k)
+            if (carbon_regions[i].easy[k]) curl_multi_remove_handle(multi, carbon_regions[i].easy[k]);
+}
+
+/* request-scoped bump allocator: whatever a request parses into is carved from a chain of
+ * blocks and released with the request in one go, so an HTTP thread makes a handful of
+ * mallocs per request rather than several per task. blocks double up to ARENA_BLOCK_MAX. */
+#define ARENA_BLOCK_MIN (16 * 1024)
+#define ARENA_BLOCK_MAX (1024 * 1024)
+
+typedef struct ArenaBlock { struct ArenaBlock *next; size_t used, size; } ArenaBlock;   /* data follows */
+typedef struct Arena { ArenaBlock *head; size_t next_size; } Arena;
+
+static void *arena_alloc(Arena *a, size_t n) {
+    n = (n + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    ArenaBlock *b = a->head;
+    if (!b || b->size - b->used < n) {
+        size_t size = a->next_size ? a->next_size : ARENA_BLOCK_MIN;
+        a->next_size = size < ARENA_BLOCK_MAX ? size * 2 : size;
+        if (size < n) size = n;
+        b = malloc(sizeof(ArenaBlock) + size);
+        b->next = a->head; b->used = 0; b->size = size;
+        a->head = b;
+    }
+    void *p = (char *)(b + 1) + b->used;
+    b->used += n;
+    return p;
+}
+
+/* grow the most recent allocation in place when it still fits, else move it */
+static void *arena_grow(Arena *a, void *p, size_t old_n, size_t new_n) {
+    ArenaBlock *b = a->head;
+    old_n = (old_n + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    new_n = (new_n + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    if (p && b && (char *)p + old_n == (char *)(b + 1) + b->used && b->size - b->used >= new_n - old_n) {
+        b->used += new_n - old_n;
+        return p;
+    }
+    void *q = arena_alloc(a, new_n);
+    if (p) memcpy(q, p, old_n);
+    return q;
+}
+
+static void arena_free(Arena *a) {
+    ArenaBlock *b = a->head;
+    while (b) { ArenaBlock *next = b->next; free(b); b = next; }
+    a->head = NULL; a->next_size = 0;
+}
+
+/* long-lived task strings (compiled commands) come from size-classed slabs: each class fits
+ * a band of typical command lengths, 64 KiB pages are carved into equal slots and a freed
+ * slot goes on its class's free list for the next task. pages are only handed back at
+ * shutdown, all at once; strings beyond the largest class are plain mallocs. allocation
+ * happens on the scheduler loop and frees on it or the completion watcher, so the lock here
+ * is never contended by HTTP threads. */
+#define TASK_STRING_PAGE (64 * 1024)
+
+static const uint32_t task_string_classes[] = { 64, 96, 128, 192, 256, 384, 512, 1024, 2048, 4096 };
+#define TASK_STRING_CLASSES ((int)(sizeof(task_string_classes) / sizeof(task_string_classes[0])))
+
+typedef struct TaskStringPage { struct TaskStringPage *next; } TaskStringPage;   /* slots follow */
+
+static pthread_mutex_t task_string_lock = PTHREAD_MUTEX_INITIALIZER;
+static TaskStringPage *task_string_pages = NULL;
+static void *task_string_free_list[TASK_STRING_CLASSES];
+static char *task_string_carve[TASK_STRING_CLASSES];      /* unused tail of the class's newest page */
+static size_t task_string_carve_left[TASK_STRING_CLASSES];
+
+/* n bytes, pointer-aligned; each slot starts with its class index */
+static char *task_string_alloc(size_t n) {
+    size_t need = n + sizeof(size_t);
+    int c = 0;
+    while (c < TASK_STRING_CLASSES && task_string_classes[c] < need) c++;
+    size_t *slot;
+    pthread_mutex_lock(&task_string_lock);
+    if (c == TASK_STRING_CLASSES) {
+        slot = malloc(need);
+    } else if (task_string_free_list[c]) {
+        slot = task_string_free_list[c];
+        task_string_free_list[c] = *(void **)slot;
+    } else {
+        if (task_string_carve_left[c] < task_string_classes[c]) {
+            TaskStringPage *page = malloc(TASK_STRING_PAGE);
+            page->next = task_string_pages;
+            task_string_pages = page;
+            task_string_carve[c] = (char *)(page + 1);
+            task_string_carve_left[c] = TASK_STRING_PAGE - sizeof(TaskStringPage);
+        }
+        slot = (size_t *)task_string_carve[c];
+        task_string_carve[c] += task_string_classes[c];
+        task_string_carve_left[c] -= task_string_classes[c];
+    }
+    pthread_mutex_unlock(&task_string_lock);
+    *slot = (size_t)c;
+    return (char *)(slot + 1);
+}
+
+static void task_string_free(char *s) {
+    if (!s) return;
+    size_t *slot = (size_t *)s - 1;
+    size_t c = *slot;
+    if (c == (size_t)TASK_STRING_CLASSES) { free(slot); return; }
+    pthread_mutex_lock(&task_string_lock);
+    *(void **)slot = task_string_free_list[c];
+    task_string_free_list[c] = slot;
+    pthread_mutex_unlock(&task_string_lock);
+}
+
+/* shutdown: drop every slab page; oversized strings must have been freed already */
+static SCHEDULER_ENTRY void task_strings_release(void) {
+    while (task_string_pages) { TaskStringPage *next = task_string_pages->next; free(task_string_pages); task_string_pages = next; }
+    memset(task_string_free_list, 0, sizeof(task_string_free_list));
+    memset(task_string_carve_left, 0, sizeof(task_string_carve_left));
+}
+
+/* commands are tokenized once, at ingest, with shell-style quoting: blanks separate words,
+ * '...' is literal, "..." honours \" \\ \$ \` and a backslash outside quotes escapes the
+ * next character. nothing is expanded: argv[0] is run directly, as before. a task's command
+ * is one block holding the text (its dedup key and journal and log form) and then its argv,
+ * so a launch does no parsing and no allocation, and freeing the text frees both. */
+static int command_blank(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+
+/* split text into words; with argv and out NULL only counts and validates. returns argc, or
+ * -1 with *error set. *bytes is the size of the word strings including terminators. */
+static int command_split(const char *s, size_t len, char **argv, char *out, size_t *bytes, const char **error) {
+    int argc = 0;
+    size_t i = 0, n = 0;
+    for (;;) {
+        while (i < len && (command_blank(s[i]) || (s[i] == '\\' && i + 1 < len && s[i + 1] == '\n'))) i += s[i] == '\\' ? 2 : 1;
+        if (i == len) break;
+        if (argv) argv[argc] = out + n;
+        argc++;
+        while (i < len && !command_blank(s[i])) {
+            char c = s[i++];
+            if (c == '\'') {
+                const char *q = memchr(s + i, '\'', len - i);
+                if (!q) { *error = "Malformed command: unterminated single quote"; return -1; }
+                if (out) memcpy(out + n, s + i, (size_t)(q - (s + i)));
+                n += (size_t)(q - (s + i));
+                i = (size_t)(q - s) + 1;
+                continue;
+            }
+            if (c == '"') {
+                for (;;) {
+                    if (i == len) { *error = "Malformed command: unterminated double quote"; return -1; }
+                    c = s[i++];
+                    if (c == '"') break;
+                    if (c == '\\' && i < len && strchr("\"\\$`\n", s[i])) {
+                        c = s[i++];
+                        if (c == '\n') continue;   /* line continuation */
+                    }
+                    if (out) out[n] = c;
+                    n++;
+                }
+                continue;
+            }
+            if (c == '\\') {
+                if (i == len) { *error = "Malformed command: trailing backslash"; return -1; }
+                c = s[i++];
+                if (c == '\n') continue;
+            }
+            if (out) out[n] = c;
+            n++;
+        }
+        if (out) out[n] = 0;
+        n++;
+    }
+    if (argc == 0) { *error = "Malformed command: no program"; return -1; }
+    *bytes = n;
+    return argc;
+}
+
+/* the compiled command block for text, or NULL with *error set (error may be NULL). it is
+ * carved from arena, or with arena NULL is a task string (task_string_free). */
+static char *command_compile(const char *text, size_t len, Arena *arena, const char **error) {
+    const char *e = "Malformed command: NUL byte";
+    size_t bytes = 0;
+    int argc = memchr(text, 0, len) ? -1 : command_split(text, len, NULL, NULL, &bytes, &e);
+    if (argc < 0) { if (error) *error = e; return NULL; }
+    size_t head = (len + sizeof(char *)) & ~(sizeof(char *) - 1);   /* text, NUL, pad to a pointer */
+    size_t size = head + sizeof(char *) * ((size_t)argc + 1) + bytes;
+    char *block = arena ? arena_alloc(arena, size) : task_string_alloc(size);
+    memcpy(block, text, len);
+    block[len] = 0;
+    char **argv = (char **)(block + head);
+    command_split(text, len, argv, (char *)(argv + argc + 1), &bytes, &e);
+    argv[argc] = NULL;
+    return block;
+}
+
+static char **command_argv(char *block) {
+    return (char **)(block + ((strlen(block) + sizeof(char *)) & ~(sizeof(char *) - 1)));
+}
+
+/* copy a compiled block into task string storage, moving its argv along */
+static char *command_adopt(char *block) {
+    char **argv = command_argv(block);
+    int argc = 0;
+    while (argv[argc]) argc++;
+    size_t size = (size_t)(argv[argc - 1] + strlen(argv[argc - 1]) + 1 - block);
+    char *copy = task_string_alloc(size);
+    memcpy(copy, block, size);
+    char **moved = command_argv(copy);
+    for (int i = 0; i < argc; ++i) moved[i] = copy + (argv[i] - block);
+    return copy;
+}
+
+/* shell-quote an argv (n > 0) into command text, which splits back into the same words, and
+ * compile it into arena; NULL with *error set if it does not compile */
+static char *command_from_argv(char *const *args, const size_t *lens, int n, Arena *arena, const char **error) {
+    size_t len = 0, cap = 0;
+    char *text = NULL;
+    for (int k = 0; k < n; ++k) {
+        const char *arg = args[k];
+        size_t alen = lens[k];
+        if (len + 4 * alen + 4 > cap) {
+            size_t old = cap;
+            while (len + 4 * alen + 4 > cap) cap = cap ? cap * 2 : 256;
+            text = arena_grow(arena, text, old, cap);
+        }
+        if (k > 0) text[len++] = ' ';
+        int plain = alen > 0;
+        for (size_t c = 0; c < alen && plain; ++c)
+            plain = isalnum((unsigned char)arg[c]) || strchr("@%+=:,./-_", arg[c]);
+        if (plain) { memcpy(text + len, arg, alen); len += alen; continue; }
+        text[len++] = '\'';
+        for (size_t c = 0; c < alen; ++c) {
+            if (arg[c] == '\'') { memcpy(text + len, "'\\''", 4); len += 4; }
+            else text[len++] = arg[c];
+        }
+        text[len++] = '\'';
+    }
+    return command_compile(text, len, arena, error);
+}
+
+/* task slot arena helpers */
+static void tasks_ensure_capacity(int need) {
+    if (task_capacity >= need) return;
+    int newcap = (task_capacity > 0) ? task_capacity * 2 : MAX_TASKS_INCREMENT;
+    while (newcap < need) newcap *= 2;
+    task_hot = realloc(task_hot, sizeof(TaskHot) * newcap);
+    task_cold = realloc(task_cold, sizeof(TaskCold) * newcap);
+    memset(task_hot + task_capacity, 0, sizeof(TaskHot) * (newcap - task_capacity));
+    memset(task_cold + task_capacity, 0, sizeof(TaskCold) * (newcap - task_capacity));
+    task_capacity = newcap;
+}
+
+static int task_slot_alloc(void) {
+    int slot;
+    if (task_free_head >= 0) { slot = task_free_head; task_free_head = task_cold[slot].next_free; }
+    else { tasks_ensure_capacity(task_count + 1); slot = task_count++; }
+    task_live++;
+    return slot;
+}
+
+/* dedup index: open-addressing hash table keyed on (command, submitted_at) -> task index.
+ * linear probing, power-of-two capacity, kept below 50% load; caller holds tasks_lock. */
+typedef struct TaskIndexSlot { uint64_t hash; int task; } TaskIndexSlot;
+
+static TaskIndexSlot *task_index = NULL;
+static size_t task_index_capacity = 0;
+static size_t task_index_count = 0;
+
+static uint64_t task_key_hash(const char *command, time_t submitted_at) {
+    uint64_t h = 1469598103934665603ULL; /* FNV-1a */
+    for (const unsigned char *p = (const unsigned char *)command; *p; ++p) { h ^= *p; h *= 1099511628211ULL; }
+    h ^= (uint64_t)submitted_at + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdULL; h ^= h >> 33;
+    return h;
+}
+
+static void task_index_place(uint64_t hash, int task) {
+    size_t mask = task_index_capacity - 1;
+    size_t i = (size_t)hash & mask;
+    while (task_index[i].task >= 0) i = (i + 1) & mask;
+    task_index[i].hash = hash;
+    task_index[i].task = task;
+}
+
+static void task_index_grow(void) {
+    TaskIndexSlot *old = task_index;
+    size_t oldcap = task_index_capacity;
+    task_index_capacity = oldcap ? oldcap * 2 : 1024;
+    task_index = malloc(sizeof(TaskIndexSlot) * task_index_capacity);
+    for (size_t i = 0; i < task_index_capacity; ++i) task_index[i].task = -1;
+    for (size_t i = 0; i < oldcap; ++i)
+        if (old[i].task >= 0) task_index_place(old[i].hash, old[i].task);
+    free(old);
+}
+
+static void task_index_insert(int task) {
+    if ((task_index_count + 1) * 2 > task_index_capacity) task_index_grow();
+    task_index_place(task_key_hash(task_cold[task].command, task_cold[task].submitted_at), task);
+    task_index_count++;
+}
+
+static int task_index_find(const char *command, time_t submitted_at) {
+    if (task_index_count == 0) return -1;
+    uint64_t hash = task_key_hash(command, submitted_at);
+    size_t mask = task_index_capacity - 1;
+    for (size_t i = (size_t)hash & mask; task_index[i].task >= 0; i = (i + 1) & mask) {
+        int t = task_index[i].task;
+        if (task_index[i].hash == hash && task_cold[t].submitted_at == submitted_at && strcmp(task_cold[t].command, command) == 0) return t;
+    }
+    return -1;
+}
+
+/* backward-shift deletion keeps probe chains intact without tombstones */
+static void task_index_remove(int task) {
+    size_t mask = task_index_capacity - 1;
+    size_t i = (size_t)task_key_hash(task_cold[task].command, task_cold[task].submitted_at) & mask;
+    while (task_index[i].task != task) i = (i + 1) & mask;
+    for (size_t j = (i + 1) & mask; task_index[j].task >= 0; j = (j + 1) & mask) {
+        size_t home = (size_t)task_index[j].hash & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) { task_index[i] = task_index[j]; i = j; }
+    }
+    task_index[i].task = -1;
+    task_index_count--;
+}
+
+/* pid -> slot map of running tasks so completion handling does not scan the arena */
+typedef struct PidMapSlot { pid_t pid; int task; uint32_t gen; } PidMapSlot;
+
+static PidMapSlot *pid_map = NULL;
+static size_t pid_map_capacity = 0;
+static size_t pid_map_count = 0;
+
+static size_t pid_hash(pid_t pid) { return (size_t)((uint32_t)pid * 2654435761u); }
+
+static void pid_map_place(PidMapSlot e) {
+    size_t mask = pid_map_capacity - 1;
+    size_t i = pid_hash(e.pid) & mask;
+    while (pid_map[i].pid > 0) i = (i + 1) & mask;
+    pid_map[i] = e;
+}
+
+static void pid_map_insert(pid_t pid, int task) {
+    if ((pid_map_count + 1) * 2 > pid_map_capacity) {
+        PidMapSlot *old = pid_map;
+        size_t oldcap = pid_map_capacity;
+        pid_map_capacity = oldcap ? oldcap * 2 : 256;
+        pid_map = calloc(pid_map_capacity, sizeof(PidMapSlot));
+        for (size_t i = 0; i < oldcap; ++i)
+            if (old[i].pid > 0) pid_map_place(old[i]);
+        free(old);
+    }
+    PidMapSlot e = { pid, task, task_cold[task].gen };
+    pid_map_place(e);
+    pid_map_count++;
+}
+
+/* returns the slot running pid and drops the mapping, or -1 if pid is not ours */
+static int pid_map_take(pid_t pid) {
+    if (pid_map_count == 0) return -1;
+    size_t mask = pid_map_capacity - 1;
+    size_t i = pid_hash(pid) & mask;
+    while (pid_map[i].pid != pid) {
+        if (pid_map[i].pid == 0) return -1;
+        i = (i + 1) & mask;
+    }
+    int task = pid_map[i].task;
+    uint32_t gen = pid_map[i].gen;
+    for (size_t j = (i + 1) & mask; pid_map[j].pid > 0; j = (j + 1) & mask) {
+        size_t home = pid_hash(pid_map[j].pid) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) { pid_map[i] = pid_map[j]; i = j; }
+    }
+    pid_map[i].pid = 0;
+    pid_map_count--;
+    return (task_hot[task].state != TASK_FREE && task_cold[task].gen == gen) ? task : -1;
+}
+
+static void task_event(int type, int slot, float delay_sec, int status) {
+    task_version++;
+    EventRecord ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.ts_ms = now_ms();
+    ev.type = (uint8_t)type;
+    ev.urgency = task_hot[slot].urgency;
+    ev.delayed = task_hot[slot].delayed;
+    ev.pid = task_hot[slot].pid;
+    ev.slot = (uint32_t)slot;
+    ev.gen = task_cold[slot].gen;
+    ev.delay_sec = delay_sec;
+    ev.status = status;
+    ev.key_hash = task_key_hash(task_cold[slot].command, task_cold[slot].submitted_at);
+    strncpy(ev.command, task_cold[slot].command, sizeof(ev.command));
+    log_event(&ev);
+}
+
+/* takes ownership of command; the task starts out pending. region is an index or REGION_ANY. */
+static void tasks_fill(int slot, char *command, Urgency urgency, int region, int deadline_hours, time_t submitted_at) {
+    TaskHot *h = &task_hot[slot];
+    TaskCold *c = &task_cold[slot];
+    h->state = TASK_PENDING;
+    h->urgency = (uint8_t)urgency;
+    h->delayed = 0;
+    h->region = (uint8_t)(region == REGION_ANY ? 0 : region);
+    h->pid = 0;
+    h->deadline = submitted_at + (time_t)deadline_hours * 3600;
+    c->command = command;
+    c->argv = command_argv(command);
+    c->submitted_at = submitted_at;
+    c->deadline_hours = deadline_hours;
+    c->region = region;
+    c->next_free = -1;
+    c->queued_us = mono_us();
+    task_index_insert(slot);
+}
+
+static int tasks_append(char *command, Urgency urgency, int region, int deadline_hours, time_t submitted_at) {
+    int slot = task_slot_alloc();
+    tasks_fill(slot, command, urgency, region, deadline_hours, submitted_at);
+    return slot;
+}
+
+/* release a completed task: drop it from the dedup index, free its command (or park it in
+ * limbo while a read view or a snapshot may point at it) and put the slot back on the free
+ * list under a new generation */
+static void tasks_retire(int slot) {
+    task_index_remove(slot);
+    if (task_view_active || journal_compacting) {
+        if (task_limbo_count == task_limbo_capacity) {
+            task_limbo_capacity = task_limbo_capacity ? task_limbo_capacity * 2 : MAX_TASKS_INCREMENT;
+            task_limbo = realloc(task_limbo, sizeof(char *) * task_limbo_capacity);
+        }
+        task_limbo[task_limbo_count++] = task_cold[slot].command;
+    } else task_string_free(task_cold[slot].command);
+    task_cold[slot].command = NULL;
+    task_version++;
+    task_hot[slot].state = TASK_FREE; task_hot[slot].delayed = 0; task_hot[slot].pid = 0;
+    task_cold[slot].gen++;
+    task_cold[slot].next_free = task_free_head;
+    task_free_head = slot;
+    task_live--;
+}
+
+static int tasks_contains(const char *command, time_t submitted_at) { return task_index_find(command, submitted_at) >= 0; }
+
+/* crash-safe journal: every task state transition is appended as a JournalRecord to
+ * JOURNAL_PREFIX.<seq>.wal, and JOURNAL_PREFIX.snap holds a compacted image of all live
+ * tasks plus the first segment to replay on top of it. records name a task by arena slot
+ * and generation, so replay rebuilds the arena, dedup index and heaps exactly as they were.
+ * appends only copy into a buffer; journal_commit writes it out, and with sync=1 also
+ * fdatasyncs. concurrent committers group up: one leader writes everything buffered so far
+ * while the others wait for it, so a submit batch or a launch batch costs one fdatasync. */
+enum { JOURNAL_SUBMIT = 1, JOURNAL_DEFER, JOURNAL_LAUNCH, JOURNAL_REQUEUE, JOURNAL_COMPLETE };
+
+typedef struct JournalRecord {
+    uint32_t checksum;       /* FNV-1a over the rest of the record, command included */
+    uint32_t command_len;    /* submit records only; the command follows, padded to 8 bytes */
+    uint8_t type;
+    uint8_t urgency;
+    uint8_t region;          /* submit records: region index + 1, 0 for any */
+    uint8_t reserved;
+    uint32_t slot;
+    uint32_t gen;
+    int32_t deadline_hours;
+    int64_t submitted_at;
+} JournalRecord;
+
+typedef struct JournalBuffer { char *data; size_t len; size_t cap; } JournalBuffer;
+
+static const char *journal_prefix = JOURNAL_PREFIX;
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t journal_cond = PTHREAD_COND_INITIALIZER;
+static JournalBuffer journal_buf[2];     /* appends go to journal_buf[journal_cur] */
+static int journal_cur = 0;
+static int journal_flushing = 0;         /* a commit leader is writing the other buffer */
+static int journal_fd = -1;              /* -1: journaling off */
+static int journal_sealed_fd = -1;       /* rolled-over segment the next sync commit must fdatasync */
+static uint64_t journal_next_seq = 0;    /* segment the next roll opens */
+static uint64_t journal_first_seq = 0;   /* oldest segment the snapshot still needs */
+static uint64_t journal_lsn = 0;         /* bytes appended so far */
+static uint64_t journal_written = 0;
+static uint64_t journal_synced = 0;
+static uint64_t journal_segment_bytes = 0;
+static uint64_t journal_snapshot_bytes = 0;
+
+static void journal_segment_path(char *buf, size_t len, uint64_t seq) {
+    snprintf(buf, len, "%s.%llu.wal", journal_prefix, (unsigned long long)seq);
+}
+
+static uint32_t journal_checksum(const void *data, size_t len) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = data; len-- > 0; ++p) { h ^= *p; h *= 16777619u; }
+    return h;
+}
+
+static size_t journal_record_size(uint32_t command_len) { return sizeof(JournalRecord) + ((command_len + 7) & ~7u); }
+
+/* buffer one transition of slot; caller holds tasks_lock. returns the position to commit
+ * up to (0 with journaling off). */
+static uint64_t journal_append(int type, int slot) {
+    if (journal_fd < 0) return 0;
+    const TaskCold *c = &task_cold[slot];
+    uint32_t command_len = type == JOURNAL_SUBMIT ? (uint32_t)strlen(c->command) : 0;
+    size_t size = journal_record_size(command_len);
+    pthread_mutex_lock(&journal_lock);
+    JournalBuffer *b = &journal_buf[journal_cur];
+    if (b->len + size > b->cap) {
+        while (b->len + size > b->cap) b->cap = b->cap ? b->cap * 2 : 65536;
+        b->data = realloc(b->data, b->cap);
+    }
+    JournalRecord *r = (JournalRecord *)(b->data + b->len);
+    memset(r, 0, size);
+    r->command_len = command_len;
+    r->type = (uint8_t)type;
+    r->urgency = task_hot[slot].urgency;
+    r->region = (uint8_t)(c->region == REGION_ANY ? 0 : c->region + 1);
+    r->slot = (uint32_t)slot;
+    r->gen = c->gen;
+    r->deadline_hours = c->deadline_hours;
+    r->submitted_at = c->submitted_at;
+    memcpy(r + 1, c->command, command_len);
+    r->checksum = journal_checksum((const char *)r + sizeof(r->checksum), size - sizeof(r->checksum));
+    b->len += size;
+    journal_lsn += size;
+    journal_segment_bytes += size;
+    uint64_t lsn = journal_lsn;
+    pthread_mutex_unlock(&journal_lock);
+    return lsn;
+}
+
+/* make everything up to lsn written (sync=0) or durable (sync=1); never called under tasks_lock */
+static void journal_commit(uint64_t lsn, int sync) {
+    pthread_mutex_lock(&journal_lock);
+    while (journal_fd >= 0 && (sync ? journal_synced : journal_written) < lsn) {
+        if (journal_flushing) { pthread_cond_wait(&journal_cond, &journal_lock); continue; }
+        JournalBuffer *b = &journal_buf[journal_cur];
+        uint64_t end = journal_lsn;
+        int fd = journal_fd, sealed = sync ? journal_sealed_fd : -1;
+        if (sync) journal_sealed_fd = -1;
+        journal_cur ^= 1;
+        journal_flushing = 1;
+        pthread_mutex_unlock(&journal_lock);
+        log_write_all(fd, b->data, b->len);
+        b->len = 0;
+        if (sync) {
+            uint64_t t0 = mono_us();
+            if (sealed >= 0 && fdatasync(sealed) != 0) log_msg("[ERROR] Journal fdatasync failed: %s\n", strerror(errno));
+            if (fdatasync(fd) != 0) log_msg("[ERROR] Journal fdatasync failed: %s\n", strerror(errno));
+            histogram_observe(HIST_JOURNAL_SYNC, mono_us() - t0);
+            if (sealed >= 0) close(sealed);
+        }
+        pthread_mutex_lock(&journal_lock);
+        journal_written = end;
+        if (sync) journal_synced = end;
+        journal_flushing = 0;
+        pthread_cond_broadcast(&journal_cond);
+    }
+    pthread_mutex_unlock(&journal_lock);
+}
+
+static void journal_flush(int sync) {
+    pthread_mutex_lock(&journal_lock);
+    uint64_t lsn = journal_lsn;
+    pthread_mutex_unlock(&journal_lock);
+    journal_commit(lsn, sync);
+}
+
+/* seal the open segment and start journal_next_seq; caller holds tasks_lock, so no record
+ * can land between a snapshot image and the segment that follows it. the sealed segment is
+ * written but not synced: the next sync commit fdatasyncs it, so pass the returned lsn to
+ * journal_commit once tasks_lock is released. */
+static uint64_t journal_roll(void) {
+    char path[256];
+    pthread_mutex_lock(&journal_lock);
+    while (journal_flushing) pthread_cond_wait(&journal_cond, &journal_lock);
+    JournalBuffer *b = &journal_buf[journal_cur];
+    if (journal_fd >= 0) {
+        log_write_all(journal_fd, b->data, b->len);
+        if (journal_sealed_fd >= 0) {   /* two rolls without a sync commit between them */
+            if (fdatasync(journal_sealed_fd) != 0) log_msg("[ERROR] Journal fdatasync failed: %s\n", strerror(errno));
+            close(journal_sealed_fd);
+        }
+        journal_sealed_fd = journal_fd;
+    }
+    b->len = 0;
+    journal_written = journal_lsn;
+    uint64_t sealed = journal_lsn;
+    journal_segment_path(path, sizeof(path), journal_next_seq++);
+    journal_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    journal_segment_bytes = 0;
+    if (journal_fd < 0 && journal_sealed_fd >= 0) {   /* no commit will run again */
+        if (fdatasync(journal_sealed_fd) != 0) log_msg("[ERROR] Journal fdatasync failed: %s\n", strerror(errno));
+        close(journal_sealed_fd);
+        journal_sealed_fd = -1;
+    }
+    pthread_mutex_unlock(&journal_lock);
+    if (journal_fd < 0) log_msg("[ERROR] Journal disabled: cannot open %s: %s\n", path, strerror(errno));
+    return sealed;
+}
+
+/* start argv (from command_compile) with posix_spawnp in environment envp; no lock is held and nothing of the
+ * daemon is copied (glibc spawns via clone(CLONE_VM|CLONE_VFORK)). the child leads a new
+ * process group and gets default signal dispositions and an empty mask. the attributes are
+ * the same for every child, so they are built once. spawn attributes cannot carry a nice
+ * value, so low-urgency children are reniced right after the spawn returns, by process
+ * group: anything the child forked in the meantime (a shell's first command, say) is in
+ * its group and reniced with it. returns 0 or an errno value. scheduler loop only. */
+static posix_spawnattr_t spawn_attr;
+static int spawn_attr_ready = 0;
+
+static SCHEDULER_ENTRY int spawn_command(char *const argv[], char *const envp[], int urgency, pid_t *out_pid) {
+    if (!spawn_attr_ready) {
+        sigset_t none, all;
+        sigemptyset(&none);
+        sigfillset(&all);
+        posix_spawnattr_init(&spawn_attr);
+        posix_spawnattr_setflags(&spawn_attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&spawn_attr, 0);   /* own process group, so preemption stops the whole job */
+        posix_spawnattr_setsigmask(&spawn_attr, &none);
+        posix_spawnattr_setsigdefault(&spawn_attr, &all);
+        spawn_attr_ready = 1;
+    }
+    int err = posix_spawnp(out_pid, argv[0], NULL, &spawn_attr, argv, envp);
+    if (err == 0 && urgency == URGENCY_LOW) setpriority(PRIO_PGRP, *out_pid, 10);   /* pgid == pid */
+    return err;
+}
+
+/* scheduler loop wake-ups: main() sleeps in epoll_wait on sched_timer_fd, armed for the
+ * next moment a pending task comes due, and sched_wake_fd, which ingest, the completion
+ * watcher, the carbon refresher and the signal handler poke when something changed. */
+static int sched_epoll_fd = -1;
+static int sched_wake_fd = -1;
+static int sched_timer_fd = -1;
+
+static SCHEDULER_ENTRY int sched_init(void) {
+    sched_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    sched_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    sched_timer_fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (sched_epoll_fd < 0 || sched_wake_fd < 0 || sched_timer_fd < 0) return -1;
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.fd = sched_wake_fd;
+    if (epoll_ctl(sched_epoll_fd, EPOLL_CTL_ADD, sched_wake_fd, &ev) != 0) return -1;
+    ev.data.fd = sched_timer_fd;
+    return epoll_ctl(sched_epoll_fd, EPOLL_CTL_ADD, sched_timer_fd, &ev);
+}
+
+/* async-signal-safe */
+static void sched_wake(void) {
+    uint64_t one = 1;
+    if (sched_wake_fd >= 0) { ssize_t r = write(sched_wake_fd, &one, sizeof(one)); (void)r; }
+}
+
+/* arm the timer for wall-clock time at, or disarm it (sleep until woken) if at is 0 */
+static SCHEDULER_ENTRY void sched_arm(time_t at) {
+    struct itimerspec its = {0};
+    its.it_value.tv_sec = at;
+    timerfd_settime(sched_timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* completion tracking: each launched child gets a pidfd registered in reap_epoll_fd, with
+ * pid and pidfd packed into the event data. a pidfd turns readable when its process exits,
+ * so the watcher reaps exactly that child and never waits on processes it did not start.
+ * a child exiting before it is registered is still a zombie, so its pidfd is readable at
+ * once. children whose pidfd_open failed (pre-5.3 kernel, fd limit) are polled with
+ * waitpid(WNOHANG) every REAP_FALLBACK_MS. reap_wake_fd wakes the watcher for shutdown. */
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+static int reap_epoll_fd = -1;
+static int reap_wake_fd = -1;
+static pid_t *reap_unwatched = NULL;   /* guarded by tasks_lock */
+static int reap_unwatched_count = 0;
+static int reap_unwatched_capacity = 0;
+
+static SCHEDULER_ENTRY int reap_init(void) {
+    reap_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    reap_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (reap_epoll_fd < 0 || reap_wake_fd < 0) return -1;
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = 0 };  /* pid 0: wake-up */
+    return epoll_ctl(reap_epoll_fd, EPOLL_CTL_ADD, reap_wake_fd, &ev);
+}
+
+/* start watching a launched child; caller holds tasks_lock */
+static SCHEDULER_ENTRY void reap_watch(pid_t pid) {
+    static int warned = 0;
+    int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    int err = errno;
+    if (pidfd >= 0) {
+        fcntl(pidfd, F_SETFD, FD_CLOEXEC);
+        struct epoll_event ev = { .events = EPOLLIN, .data.u64 = ((uint64_t)(uint32_t)pidfd << 32) | (uint32_t)pid };
+        if (epoll_ctl(reap_epoll_fd, EPOLL_CTL_ADD, pidfd, &ev) == 0) return;
+        err = errno;
+        close(pidfd);
+    }
+    if (!warned) { log_msg("[WARN] Cannot watch PID %d with a pidfd (%s); polling instead\n", pid, strerror(err)); warned = 1; }
+    if (reap_unwatched_count == reap_unwatched_capacity) {
+        reap_unwatched_capacity = reap_unwatched_capacity ? reap_unwatched_capacity * 2 : MAX_TASKS_INCREMENT;
+        reap_unwatched = realloc(reap_unwatched, sizeof(pid_t) * reap_unwatched_capacity);
+    }
+    reap_unwatched[reap_unwatched_count] = pid;
+    __atomic_store_n(&reap_unwatched_count, reap_unwatched_count + 1, __ATOMIC_RELAXED);  /* read by the watcher unlocked */
+}
+
+/* record a finished task and retire its slot; caller holds tasks_lock. the task is charged
+ * its CPU time at CPU_WATTS_PER_CORE times the average forecast intensity while it ran. */
+static void task_active_add(int slot) {
+    if (task_active_count == task_active_capacity) {
+        task_active_capacity = task_active_capacity ? task_active_capacity * 2 : MAX_TASKS_INCREMENT;
+        task_active = realloc(task_active, sizeof(int) * task_active_capacity);
+    }
+    task_cold[slot].active_pos = task_active_count;
+    task_active[task_active_count++] = slot;
+}
+
+static void task_active_remove(int slot) {
+    int pos = task_cold[slot].active_pos, last = task_active[--task_active_count];
+    task_active[pos] = last;
+    task_cold[last].active_pos = pos;
+}
+
+/* a task whose command can never start ends here instead of in task_complete: it still gets
+ * its usage line and EVENT_COMPLETED (status -errno) so the log, the event readers and the
+ * shutdown totals see it end, not just vanish after EVENT_SUBMITTED. */
+static void task_spawn_failed(int slot, time_t now, int err) {
+    TaskCold *cold = &task_cold[slot];
+    double delay = difftime(now, cold->submitted_at);
+    log_msg("[USAGE] %s | PID: 0 | Spawn failed: %s | Run: 0 sec\n", cold->command, strerror(err));
+    UsageTotals *u = &usage_totals[task_hot[slot].urgency];
+    u->tasks++;
+    u->failed++;
+    task_event(EVENT_COMPLETED, slot, (float)delay, -err);
+    journal_append(JOURNAL_COMPLETE, slot);
+    tasks_retire(slot);
+}
+
+static void task_complete(int slot, pid_t pid, time_t end, int status, const struct rusage *ru) {
+    TaskCold *cold = &task_cold[slot];
+    int urgency = task_hot[slot].urgency;
+    task_running[urgency]--;
+    if (task_hot[slot].state == TASK_SUSPENDED) { task_suspended[urgency]--; depth_add(urgency, DEPTH_SUSPENDED, -1); }
+    else depth_add(urgency, DEPTH_RUNNING, -1);
+    double delay = difftime(end, cold->submitted_at);
+    total_delay_seconds += delay;
+    completed_tasks++;
+    log_msg("[TASK] Completed: %s | PID: %d | Delay: %.0f sec\n", cold->command, pid, delay);
+
+    double user = ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6;
+    double sys = ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6;
+    CarbonSnapshot carbon;
+    carbon_snapshot_read(task_hot[slot].region, &carbon);
+    double ran = difftime(end, cold->started_at) - cold->suspended_sec;
+    double odometer = cold->odometer_run + carbon_odometer(&carbon, end) - cold->odometer_at_start;
+    double intensity = ran > 0 ? odometer / ran : carbon.rate;
+    double gco2 = (user + sys) * CPU_WATTS_PER_CORE / 3.6e6 * intensity;
+    int failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    histogram_observe(HIST_RUN, mono_us() - cold->started_us);
+    counter_add(COUNTER_COMPLETED, 1);
+    counter_add(COUNTER_FAILED, (uint64_t)failed);
+    char outcome[32];
+    if (WIFSIGNALED(status)) snprintf(outcome, sizeof(outcome), "Signal: %d", WTERMSIG(status));
+    else snprintf(outcome, sizeof(outcome), "Exit: %d", WEXITSTATUS(status));
+    log_msg("[USAGE] %s | PID: %d | %s | Run: %.0f sec | Suspended: %.0f sec | CPU: %.3f sec (user %.3f, sys %.3f) | "
+            "Max RSS: %ld KB | Blocks in/out: %ld/%ld | Intensity: %.0f gCO2/kWh | Est: %.4f gCO2\n",
+            cold->command, pid, outcome, ran, cold->suspended_sec, user + sys, user, sys, ru->ru_maxrss,
+            ru->ru_inblock, ru->ru_oublock, intensity, gco2);
+
+    UsageTotals *u = &usage_totals[urgency];
+    u->tasks++;
+    u->failed += failed;
+    u->cpu_sec += user + sys;
+    u->gco2 += gco2;
+    if (ru->ru_maxrss > u->max_rss_kb) u->max_rss_kb = ru->ru_maxrss;
+    u->suspended_sec += cold->suspended_sec;
+    task_event(EVENT_COMPLETED, slot, (float)delay, status);
+    journal_append(JOURNAL_COMPLETE, slot);
+    task_active_remove(slot);
+    tasks_retire(slot);
+}
+
+/* pending queues: one binary min-heap of not-yet-started tasks per urgency class, so a
+ * class at its concurrency cap never blocks the others, and per region the task is pinned
+ * to, with tasks that accept any region in group PENDING_ANY. urgent tasks are keyed at 0 so
+ * they are always due; deferrable tasks are keyed by deadline, ties broken by arrival.
+ * started tasks never sit in a heap, so a scheduling pass only pops what it releases
+ * instead of rescanning the arena. caller holds tasks_lock. */
+#define PENDING_ANY MAX_REGIONS
+#define PENDING_GROUPS (MAX_REGIONS + 1)
+
+typedef struct PendingEntry { time_t key; int task; } PendingEntry;
+typedef struct PendingHeap { PendingEntry *items; int count; int capacity; } PendingHeap;
+
+static PendingHeap pending[PENDING_GROUPS][URGENCY_COUNT];
+
+static int pending_group(int task) { return task_cold[task].region == REGION_ANY ? PENDING_ANY : task_cold[task].region; }
+
+static int pending_less(const PendingEntry *a, const PendingEntry *b) {
+    if (a->key != b->key) return a->key < b->key;
+    return a->task < b->task;
+}
+
+static void pending_push(int task) {
+    int rank = task_hot[task].urgency;
+    PendingHeap *h = &pending[pending_group(task)][rank];
+    if (h->count == h->capacity) {
+        h->capacity = h->capacity ? h->capacity * 2 : MAX_TASKS_INCREMENT;
+        h->items = realloc(h->items, sizeof(PendingEntry) * h->capacity);
+    }
+    PendingEntry e = { rank == URGENCY_HIGH ? 0 : task_hot[task].deadline, task };
+    int i = h->count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!pending_less(&e, &h->items[parent])) break;
+        h->items[i] = h->items[parent];
+        i = parent;
+    }
+    h->items[i] = e;
+    depth_add(rank, DEPTH_PENDING, 1);
+}
+
+static int pending_pop(PendingHeap *h) {
+    int top = h->items[0].task;
+    PendingEntry last = h->items[--h->count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= h->count) break;
+        if (child + 1 < h->count && pending_less(&h->items[child + 1], &h->items[child])) child++;
+        if (!pending_less(&h->items[child], &last)) break;
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    if (h->count > 0) h->items[i] = last;
+    depth_add(task_hot[top].urgency, DEPTH_PENDING, -1);
+    return top;
+}
+
+static int pending_total(void) {
+    int n = 0;
+    for (int g = 0; g < PENDING_GROUPS; ++g)
+        for (int r = 0; r < URGENCY_COUNT; ++r) n += pending[g][r].count;
+    return n;
+}
+
+/* is a pending entry with this heap key (deadline, or 0 if urgent) due now in region? with
+ * a live forecast a deferrable task waits for its planned slot; without one it falls back
+ * to the high-carbon deferral rule. true for every key below a due one. caller holds
+ * tasks_lock. */
+static int region_due(int region, time_t key, time_t now, const CarbonSnapshot *carbon) {
+    if (key <= now) return 1;
+    const ForecastPlan *plan = forecast_plan_live(region, now);
+    if (plan) return forecast_plan_start(plan, key) <= now;
+    return !carbon_is_high(carbon);
+}
+
+/* bit i set while region i's reading is fresh enough to schedule on */
+static unsigned carbon_fresh_mask(const CarbonSnapshot *carbon, time_t now) {
+    unsigned mask = 0;
+    for (int i = 0; i < carbon_region_count; ++i)
+        if (!carbon_is_stale(i, &carbon[i], now)) mask |= 1u << i;
+    return mask;
+}
+
+/* lower intensity first; a region whose level is unknown comes after every known one */
+static int carbon_greener(const CarbonSnapshot *a, const CarbonSnapshot *b) {
+    if ((a->level == CARBON_UNKNOWN) != (b->level == CARBON_UNKNOWN)) return b->level == CARBON_UNKNOWN;
+    return a->rate < b->rate;
+}
+
+/* the region a heap top of this group can start in now, or -1. only regions in the usable
+ * mask are considered, except for urgent tasks and tasks past their deadline (key <= now),
+ * which never wait on carbon; a task that accepts any region goes to the greenest of those
+ * where it is due. carbon is indexed by region. */
+static int pending_due(int group, time_t key, time_t now, const CarbonSnapshot *carbon, unsigned usable) {
+    if (key <= now) usable = ~0u;
+    if (group != PENDING_ANY) return (usable >> group & 1) && region_due(group, key, now, &carbon[group]) ? group : -1;
+    int best = -1;
+    for (int i = 0; i < carbon_region_count; ++i)
+        if ((usable >> i & 1) && region_due(i, key, now, &carbon[i]) && (best < 0 || carbon_greener(&carbon[i], &carbon[best]))) best = i;
+    return best;
+}
+
+/* the earliest planned forecast start before key in the group's regions, or 0 if none of
+ * them plans one after now */
+static time_t pending_planned(int group, time_t key, time_t now) {
+    time_t at = 0;
+    int first = group == PENDING_ANY ? 0 : group, last = group == PENDING_ANY ? carbon_region_count : group + 1;
+    for (int i = first; i < last; ++i) {
+        const ForecastPlan *plan = forecast_plan_live(i, now);
+        time_t start = plan ? forecast_plan_start(plan, key) : 0;
+        if (start > now && start < key && (at == 0 || start < at)) at = start;
+    }
+    return at;
+}
+
+/* snapshot image: header, one fixed SnapshotEntry per live task, then the command bytes,
+ * so recovery reads it straight out of an mmap. started tasks (launched but not known to
+ * have finished) are kept only so replay can match their completion records. */
+typedef struct SnapshotHeader {
+    char magic[8];           /* "GSSNAP01" */
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t count;
+    uint64_t slot_count;     /* arena high-water mark */
+    uint64_t journal_seq;    /* first segment to replay on top */
+    uint64_t strings_bytes;
+    int64_t created_ms;
+    uint64_t reserved;
+} SnapshotHeader;
+
+typedef struct SnapshotEntry {
+    uint32_t slot;
+    uint32_t gen;
+    int64_t submitted_at;
+    uint64_t command_off;
+    uint32_t command_len;
+    int32_t deadline_hours;
+    uint8_t urgency;
+    uint8_t started;
+    uint8_t delayed;
+    uint8_t region;          /* as in JournalRecord */
+    uint8_t reserved[4];
+} SnapshotEntry;
+
+#define JOURNAL_MAX_SLOT (1 << 30)
+
+static void journal_snapshot_path(char *buf, size_t len, const char *suffix) {
+    snprintf(buf, len, "%s.snap%s", journal_prefix, suffix);
+}
+
+/* write a snapshot of every live task, then drop the segments it covers. under tasks_lock
+ * only the fixed-size entries are copied (with command pointers, not the strings) and the
+ * open segment is sealed, so the image matches the segment that follows it exactly. the
+ * strings are gathered, the sealed segment synced and the file written without the lock;
+ * meanwhile retired commands wait in limbo (journal_compacting). */
+static void journal_compact(void) {
+    char path[256], tmp[256];
+    size_t count = 0, capacity = 0;
+    SnapshotEntry *entries = NULL;
+    const char **commands = NULL;
+    tasks_lock_acquire();
+    while ((size_t)task_live > capacity) {   /* allocated and faulted in without the lock */
+        capacity = (size_t)task_live + (size_t)task_live / 8 + MAX_TASKS_INCREMENT;
+        tasks_lock_release();
+        free(entries);
+        free(commands);
+        entries = malloc(sizeof(SnapshotEntry) * capacity);
+        commands = malloc(sizeof(char *) * capacity);
+        if (!entries || !commands) {
+            free(entries);
+            free(commands);
+            log_msg("[ERROR] Journal compaction skipped: no memory for %zu snapshot entries\n", capacity);
+            return;
+        }
+        memset(entries, 0, sizeof(SnapshotEntry) * capacity);
+        memset(commands, 0, sizeof(char *) * capacity);
+        tasks_lock_acquire();
+    }
+    count = (size_t)task_live;
+    SnapshotEntry *e = entries;
+    for (int i = 0; i < task_count; ++i) {
+        const TaskHot *h = &task_hot[i];
+        if (h->state == TASK_FREE) continue;
+        const TaskCold *c = &task_cold[i];
+        e->slot = (uint32_t)i;
+        e->gen = c->gen;
+        e->submitted_at = c->submitted_at;
+        e->deadline_hours = c->deadline_hours;
+        e->urgency = h->urgency;
+        e->started = h->state != TASK_PENDING;
+        e->delayed = h->delayed;
+        e->region = (uint8_t)(c->region == REGION_ANY ? 0 : c->region + 1);
+        commands[e++ - entries] = c->command;
+    }
+    uint64_t first_seq = journal_first_seq, next_seq = journal_next_seq, slot_count = (uint64_t)task_count;
+    journal_compacting = 1;
+    uint64_t sealed = journal_roll();
+    tasks_lock_release();
+    journal_commit(sealed, 1);
+
+    size_t strings = 0;
+    for (size_t k = 0; k < count; ++k) {
+        entries[k].command_off = strings;
+        entries[k].command_len = (uint32_t)strlen(commands[k]);
+        strings += entries[k].command_len;
+    }
+    size_t size = sizeof(SnapshotHeader) + sizeof(SnapshotEntry) * count + strings;
+    char *image = malloc(size);
+    if (image) {
+        SnapshotHeader *hdr = (SnapshotHeader *)image;
+        memset(hdr, 0, sizeof(*hdr));
+        memcpy(hdr->magic, "GSSNAP01", 8);
+        hdr->version = 1;
+        hdr->entry_size = sizeof(SnapshotEntry);
+        hdr->count = (uint64_t)count;
+        hdr->slot_count = slot_count;
+        hdr->journal_seq = next_seq;
+        hdr->strings_bytes = strings;
+        hdr->created_ms = now_ms();
+        memcpy(hdr + 1, entries, sizeof(SnapshotEntry) * count);
+        char *str = image + sizeof(SnapshotHeader) + sizeof(SnapshotEntry) * count;
+        for (size_t k = 0; k < count; ++k) memcpy(str + entries[k].command_off, commands[k], entries[k].command_len);
+    }
+    free(entries);
+    free(commands);
+    tasks_lock_acquire();
+    journal_compacting = 0;
+    char **limbo = task_view_active ? NULL : task_limbo;   /* else the read view frees them */
+    int limbo_count = task_view_active ? 0 : task_limbo_count;
+    if (!task_view_active) { task_limbo = NULL; task_limbo_count = task_limbo_capacity = 0; }
+    tasks_lock_release();
+    for (int i = 0; i < limbo_count; ++i) task_string_free(limbo[i]);
+    free(limbo);
+    if (!image) { log_msg("[ERROR] Journal compaction skipped: no memory for a %.1f MB snapshot\n", size / 1048576.0); return; }
+
+    journal_snapshot_path(path, sizeof(path), "");
+    journal_snapshot_path(tmp, sizeof(tmp), ".tmp");
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) { log_msg("[ERROR] Cannot write journal snapshot %s: %s\n", tmp, strerror(errno)); free(image); return; }
+    log_write_all(fd, image, size);
+    int failed = fsync(fd) != 0;
+    close(fd);
+    free(image);
+    if (failed || rename(tmp, path) != 0) { log_msg("[ERROR] Cannot install journal snapshot %s: %s\n", path, strerror(errno)); return; }
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s", path);
+    int dfd = open(dirname(dir), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) { fsync(dfd); close(dfd); }
+    for (uint64_t seq = first_seq; seq < next_seq; ++seq) {
+        journal_segment_path(tmp, sizeof(tmp), seq);
+        unlink(tmp);
+    }
+    journal_first_seq = next_seq;
+    journal_snapshot_bytes = size;
+    log_msg("[INFO] Journal compacted: %llu tasks in snapshot (%.1f MB)\n", (unsigned long long)count, size / 1048576.0);
+}
+
+/* map a whole file read-only; an empty file maps to NULL with size 0. -1 if it cannot be opened. */
+static int journal_map(const char *path, const char **data, size_t *size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    void *p = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (p == MAP_FAILED) { close(fd); return -1; }
+    }
+    close(fd);
+    *data = p;
+    *size = p ? (size_t)st.st_size : 0;
+    return 0;
+}
+
+/* put a recovered task back into its original slot and generation. regions are recorded by
+ * position in the --region list; one that is no longer configured becomes "any". */
+static void journal_place(uint32_t slot, uint32_t gen, const char *command, uint32_t command_len, int urgency,
+                          int region, int deadline_hours, time_t submitted_at) {
+    if (slot >= JOURNAL_MAX_SLOT || urgency >= URGENCY_COUNT) return;
+    tasks_ensure_capacity((int)slot + 1);
+    if ((int)slot >= task_count) task_count = (int)slot + 1;
+    if (task_hot[slot].state != TASK_FREE) return;
+    char *block = command_compile(command, command_len, NULL, NULL);
+    if (!block) { log_msg("[WARN] Journal: dropping task with malformed command: %.*s\n", (int)command_len, command); return; }
+    task_live++;
+    task_cold[slot].gen = gen;
+    tasks_fill((int)slot, block, (Urgency)urgency, region == 0 || region > carbon_region_count ? REGION_ANY : region - 1,
+               deadline_hours, submitted_at);
+}
+
+static void journal_replay(const JournalRecord *r, const char *command) {
+    if (r->type == JOURNAL_SUBMIT) {
+        journal_place(r->slot, r->gen, command, r->command_len, r->urgency, r->region, r->deadline_hours, r->submitted_at);
+        return;
+    }
+    if ((int)r->slot >= task_count || task_hot[r->slot].state == TASK_FREE || task_cold[r->slot].gen != r->gen) return;
+    TaskHot *h = &task_hot[r->slot];
+    switch (r->type) {
+    case JOURNAL_DEFER: h->delayed = 1; break;
+    case JOURNAL_LAUNCH: h->state = TASK_RUNNING; break;
+    case JOURNAL_REQUEUE: h->state = TASK_PENDING; break;
+    case JOURNAL_COMPLETE: tasks_retire((int)r->slot); break;
+    }
+}
+
+/* rebuild the queue from the snapshot and the segments after it. a task that had been
+ * launched but never completed is not started again: its child outlived us or died with
+ * us, and running it twice is worse than reporting it. returns 0, or -1 if the snapshot is
+ * unreadable. */
+static int journal_recover(void) {
+    char path[256];
+    const char *data;
+    size_t size;
+    double t0 = now_ms();
+    uint64_t seq = 0, records = 0, from_snapshot = 0;
+    journal_snapshot_path(path, sizeof(path), "");
+    if (journal_map(path, &data, &size) == 0) {
+        SnapshotHeader hdr;
+        if (size < sizeof(hdr)) { log_msg("[ERROR] Journal snapshot %s is truncated\n", path); if (data) munmap((void *)data, size); return -1; }
+        memcpy(&hdr, data, sizeof(hdr));
+        if (memcmp(hdr.magic, "GSSNAP01", 8) != 0 || hdr.entry_size != sizeof(SnapshotEntry) || hdr.slot_count > JOURNAL_MAX_SLOT ||
+            hdr.count > hdr.slot_count || size < sizeof(hdr) + hdr.count * sizeof(SnapshotEntry) + hdr.strings_bytes) {
+            log_msg("[ERROR] Journal snapshot %s is corrupt\n", path);
+            munmap((void *)data, size);
+            return -1;
+        }
+        tasks_ensure_capacity((int)hdr.slot_count);
+        while (task_index_capacity < hdr.count * 2) task_index_grow();
+        const SnapshotEntry *e = (const SnapshotEntry *)(data + sizeof(hdr));
+        const char *strings = (const char *)(e + hdr.count);
+        for (uint64_t i = 0; i < hdr.count; ++i, ++e) {
+            if (e->command_off + e->command_len > hdr.strings_bytes) continue;
+            journal_place(e->slot, e->gen, strings + e->command_off, e->command_len, e->urgency, e->region, e->deadline_hours,
+                          e->submitted_at);
+            if ((int)e->slot < task_count && task_cold[e->slot].gen == e->gen) {
+                task_hot[e->slot].delayed = e->delayed;
+                if (e->started) task_hot[e->slot].state = TASK_RUNNING;
+            }
+        }
+        from_snapshot = hdr.count;
+        seq = hdr.journal_seq;
+        munmap((void *)data, size);
+    }
+    journal_first_seq = seq;
+    for (;; ++seq) {
+        journal_segment_path(path, sizeof(path), seq);
+        if (journal_map(path, &data, &size) != 0) break;
+        size_t off = 0;
+        while (off + sizeof(JournalRecord) <= size) {
+            JournalRecord r;
+            memcpy(&r, data + off, sizeof(r));
+            size_t n = journal_record_size(r.command_len);
+            if (r.command_len > size || off + n > size ||
+                journal_checksum(data + off + sizeof(r.checksum), n - sizeof(r.checksum)) != r.checksum) break;
+            journal_replay(&r, data + off + sizeof(r));
+            off += n;
+            records++;
+        }
+        if (data) munmap((void *)data, size);
+        if (off < size) {   /* torn tail of the last write before the crash */
+            log_msg("[WARN] Journal %s: ignoring %zu bytes after the last intact record\n", path, size - off);
+            ++seq;
+            break;
+        }
+    }
+    journal_next_seq = seq;
+
+    /* back to a consistent arena: free list, pending heaps, and no phantom children */
+    int queued = 0, lost = 0;
+    task_free_head = -1;
+    for (int i = task_count - 1; i >= 0; --i) {
+        TaskHot *h = &task_hot[i];
+        if (h->state == TASK_FREE) { task_cold[i].next_free = task_free_head; task_free_head = i; }
+        else if (h->state == TASK_PENDING) { pending_push(i); queued++; }
+        else {
+            log_msg("[WARN] Task was running when the scheduler stopped, not restarted: %s\n", task_cold[i].command);
+            tasks_retire(i);
+            lost++;
+        }
+    }
+    if (queued + lost > 0 || records > 0)
+        log_msg("[INFO] Recovered %d pending tasks (%d lost) from %llu snapshot entries and %llu journal records in %.0f ms\n",
+                queued, lost, (unsigned long long)from_snapshot, (unsigned long long)records, now_ms() - t0);
+    return 0;
+}
+
+/* recover, then fold the replayed segments into a fresh snapshot and open the next segment */
+static SCHEDULER_ENTRY int journal_start(void) {
+    if (journal_recover() != 0) return -1;
+    journal_compact();
+    return journal_fd >= 0 ? 0 : -1;
+}
+
+/* called by the scheduler loop: hand completions and requeues to the kernel (they need not
+ * be durable; a lost completion only makes recovery report the task as lost), and compact
+ * once the segment outgrows the last snapshot */
+static SCHEDULER_ENTRY void journal_maintain(void) {
+    journal_flush(0);
+    pthread_mutex_lock(&journal_lock);
+    uint64_t bytes = journal_segment_bytes;
+    pthread_mutex_unlock(&journal_lock);
+    if (journal_fd >= 0 && bytes > JOURNAL_COMPACT_BYTES && bytes > journal_snapshot_bytes) journal_compact();
+}
+
+static SCHEDULER_ENTRY void journal_shutdown(void) {
+    journal_flush(1);
+    if (journal_fd >= 0) close(journal_fd);
+    journal_fd = -1;
+    for (int i = 0; i < 2; ++i) { free(journal_buf[i].data); journal_buf[i] = (JournalBuffer){0}; }
+}
+
+/* launch batches: tasks are picked and marked TASK_LAUNCHING under tasks_lock, spawned with
+ * the lock released, then recorded (or pushed back to pending on failure) under the lock
+ * again, so a burst of releases never holds the lock across process creation */
+typedef struct LaunchItem { int slot; const char *command; char *const *argv; char *const *envp; int urgency; pid_t pid; int err; } LaunchItem;
+typedef struct LaunchBatch { LaunchItem *items; int count; int capacity; uint64_t journal_lsn; } LaunchBatch;
+
+static void launch_batch_add(LaunchBatch *b, int slot, int region) {
+    if (b->count == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : MAX_TASKS_INCREMENT;
+        b->items = realloc(b->items, sizeof(LaunchItem) * b->capacity);
+    }
+    LaunchItem *it = &b->items[b->count++];
+    it->slot = slot;
+    it->command = task_cold[slot].command;   /* stays valid: launching tasks are never retired */
+    it->argv = task_cold[slot].argv;
+    it->envp = carbon_regions[region].envp;
+    it->urgency = task_hot[slot].urgency;
+    it->pid = 0;
+    it->err = 0;
+    task_hot[slot].state = TASK_LAUNCHING;
+    task_hot[slot].region = (uint8_t)region;
+    task_running[it->urgency]++;
+    depth_add(it->urgency, DEPTH_RUNNING, 1);
+    b->journal_lsn = journal_append(JOURNAL_LAUNCH, slot);
+}
+
+static void launch_batch_finish(LaunchBatch *b) {
+    CarbonSnapshot carbon[MAX_REGIONS];
+    carbon_snapshot_read_all(carbon);
+    time_t now = clock_now();
+    for (int i = 0; i < b->count; ++i) {
+        LaunchItem *it = &b->items[i];
+        TaskHot *task = &task_hot[it->slot];
+        if (it->err != 0) {
+            log_msg("[ERROR] Failed to launch %s: %s\n", it->command, strerror(it->err));
+            counter_add(COUNTER_LAUNCH_FAILED, 1);
+            task_running[it->urgency]--;
+            depth_add(it->urgency, DEPTH_RUNNING, -1);
+            /* out of processes or memory: retry next pass; a bad command never will start */
+            if (it->err == EAGAIN || it->err == ENOMEM) {
+                task->state = TASK_PENDING;
+                pending_push(it->slot);
+                journal_append(JOURNAL_REQUEUE, it->slot);
+            } else {
+                task_spawn_failed(it->slot, now, it->err);
+            }
+            continue;
+        }
+        task->pid = it->pid;
+        task->state = TASK_RUNNING;
+        task_active_add(it->slot);
+        task_cold[it->slot].started_at = now;
+        task_cold[it->slot].odometer_at_start = carbon_odometer(&carbon[task->region], now);
+        task_cold[it->slot].odometer_run = 0;
+        task_cold[it->slot].suspended_sec = 0;
+        task_cold[it->slot].started_us = mono_us();
+        histogram_observe(HIST_QUEUE_WAIT, task_cold[it->slot].started_us - task_cold[it->slot].queued_us);
+        counter_add(COUNTER_LAUNCHED, 1);
+        log_msg("[TASK] Launched: %s | PID: %d | Delayed: %s | Region: %s\n", it->command, it->pid, task->delayed ? "yes" : "no",
+                region_name(task->region));
+        task_event(EVENT_LAUNCHED, it->slot, 0, 0);
+        pid_map_insert(it->pid, it->slot);
+        exec_watch(it->pid);
+    }
+    b->count = 0;
+}
+
+/* spawn everything in the batch without tasks_lock, then record the results under it. the
+ * launch records are made durable first, so a crash can never lead to a second start. */
+static void launch_batch_run(LaunchBatch *b) {
+    if (b->count == 0) return;
+    journal_commit(b->journal_lsn, 1);
+    for (int i = 0; i < b->count; ++i) {
+        uint64_t t0 = mono_us();
+        b->items[i].err = exec_spawn(b->items[i].argv, b->items[i].envp, b->items[i].urgency, &b->items[i].pid);
+        histogram_observe(HIST_SPAWN, mono_us() - t0);
+    }
+    tasks_lock_acquire();
+    launch_batch_finish(b);
+    tasks_lock_release();
+}
+
+/* move every pending task that is due (pending_due) in a region with a fresh reading into
+ * the launch batch, as long as its class is under max_running. caller holds tasks_lock. */
+static void schedule_pending(const CarbonSnapshot *carbon, time_t now, LaunchBatch *batch) {
+    unsigned fresh = carbon_fresh_mask(carbon, now);
+    for (int r = 0; r < URGENCY_COUNT; ++r)
+        for (int g = 0; g < PENDING_GROUPS; ++g) {
+            PendingHeap *h = &pending[g][r];
+            int region;
+            while (h->count > 0 && task_running[r] < (int)max_running[r] &&
+                   (region = pending_due(g, h->items[0].key, now, carbon, fresh)) >= 0)
+                launch_batch_add(batch, pending_pop(h), region);
+        }
+}
+
+/* fill every class up to its cap. the scheduler loop runs this after ingest, after each
+ * completion and when a planned start or deadline arrives, so a backlog drains at the rate
+ * children finish rather than all in one pass. returns the number of tasks started. */
+static int scheduler_pass(LaunchBatch *batch) {
+    CarbonSnapshot carbon[MAX_REGIONS];
+    carbon_snapshot_read_all(carbon);
+    tasks_lock_acquire();
+    schedule_pending(carbon, clock_now(), batch);
+    tasks_lock_release();
+    int started = batch->count;
+    launch_batch_run(batch);
+    return started;
+}
+
+/* the next time a heap top of a class with free capacity comes due (its planned start or
+ * its deadline), or a live plan runs out; 0 if nothing will come due by itself. classes at
+ * their cap are left to the completion wake-up. a group without a region in fresh (the
+ * carbon_fresh_mask) only plans by its deadline; the refresher's wake-up covers the rest.
+ * caller holds tasks_lock. */
+static time_t pending_next_due(time_t now, unsigned fresh) {
+    time_t next = 0;
+    for (int i = 0; i < carbon_region_count; ++i) {
+        const ForecastPlan *plan = forecast_plan_live(i, now);
+        if (plan && (next == 0 || plan->slots[plan->count - 1].to < next)) next = plan->slots[plan->count - 1].to;
+    }
+    for (int r = 0; r < URGENCY_COUNT; ++r)
+        for (int g = 0; g < PENDING_GROUPS; ++g) {
+            const PendingHeap *h = &pending[g][r];
+            if (h->count == 0 || task_running[r] >= (int)max_running[r]) continue;
+            int usable = g == PENDING_ANY ? fresh != 0 : fresh >> g & 1;
+            time_t at = usable ? pending_planned(g, h->items[0].key, now) : 0;
+            if (at == 0) at = h->items[0].key;
+            if (at <= now) at = now + 1;   /* due but not started (failed launch): retry shortly */
+            if (next == 0 || at < next) next = at;
+        }
+    return next;
+}
+
+/* stop or continue a task's process group (or just the child, if it left the group) */
+static int task_signal(int slot, int sig) {
+    pid_t pid = task_hot[slot].pid;
+    if (exec_kill(-pid, sig) == 0 || exec_kill(pid, sig) == 0) return 0;
+    return -1;
+}
+
+static void task_suspend(int slot, const CarbonSnapshot *carbon, time_t now) {
+    if (task_signal(slot, SIGSTOP) != 0) return;
+    TaskCold *cold = &task_cold[slot];
+    task_hot[slot].state = TASK_SUSPENDED;
+    task_suspended[task_hot[slot].urgency]++;
+    depth_add(task_hot[slot].urgency, DEPTH_RUNNING, -1);
+    depth_add(task_hot[slot].urgency, DEPTH_SUSPENDED, 1);
+    cold->suspended_at = now;
+    cold->odometer_run += carbon_odometer(carbon, now) - cold->odometer_at_start;
+    log_msg("[TASK] Suspended (high carbon): %s | PID: %d\n", cold->command, task_hot[slot].pid);
+    task_event(EVENT_SUSPENDED, slot, 0, 0);
+}
+
+static void task_resume(int slot, const CarbonSnapshot *carbon, time_t now, const char *why) {
+    if (task_signal(slot, SIGCONT) != 0) return;
+    TaskCold *cold = &task_cold[slot];
+    double stopped = difftime(now, cold->suspended_at);
+    task_hot[slot].state = TASK_RUNNING;
+    task_suspended[task_hot[slot].urgency]--;
+    depth_add(task_hot[slot].urgency, DEPTH_SUSPENDED, -1);
+    depth_add(task_hot[slot].urgency, DEPTH_RUNNING, 1);
+    cold->suspended_sec += stopped;
+    cold->odometer_at_start = carbon_odometer(carbon, now);
+    log_msg("[TASK] Resumed (%s): %s | PID: %d | Suspended: %.0f sec\n", why, cold->command, task_hot[slot].pid, stopped);
+    task_event(EVENT_RESUMED, slot, (float)stopped, 0);
+}
+
+/* preemption pass over the running and suspended tasks (task_active), so its cost follows
+ * the admission caps, not the queue: while preemption is in force in a task's region,
+ * running non-urgent tasks that still have time before their deadline are stopped; they
+ * are continued when it lifts or their deadline arrives. with resume_all every suspended
+ * task is continued (shutdown). carbon is indexed by region. caller holds tasks_lock. */
+static time_t preempt_apply(const CarbonSnapshot *carbon, time_t now, int resume_all) {
+    time_t next_resume = 0;
+    for (int k = 0; k < task_active_count; ++k) {
+        int i = task_active[k];
+        TaskHot *hot = &task_hot[i];
+        const CarbonSnapshot *c = &carbon[hot->region];
+        if (hot->state == TASK_RUNNING && c->preempting && !resume_all &&
+            hot->urgency != URGENCY_HIGH && now < hot->deadline)
+            task_suspend(i, c, now);
+        else if (hot->state == TASK_SUSPENDED && (resume_all || !c->preempting || now >= hot->deadline))
+            task_resume(i, c, now, resume_all ? "shutdown" : now >= hot->deadline ? "deadline" : "carbon dropped");
+        if (hot->state == TASK_SUSPENDED && (next_resume == 0 || hot->deadline < next_resume)) next_resume = hot->deadline;
+    }
+    return next_resume;
+}
+
+/* returns the earliest deadline among suspended tasks (0 if none), when one must resume */
+static time_t preempt_pass(void) {
+    if (preempt_level == CARBON_UNKNOWN) return 0;
+    CarbonSnapshot carbon[MAX_REGIONS];
+    carbon_snapshot_read_all(carbon);
+    tasks_lock_acquire();
+    time_t next_resume = preempt_apply(carbon, clock_now(), 0);
+    tasks_lock_release();
+    return next_resume;
+}
+
+/* one scheduler loop iteration after ingest: preemption, admission and the backlog status
+ * line. returns when the loop must run again by itself (0 if only a wake-up will do). while
+ * a region's carbon snapshot is stale only urgent tasks and tasks past their deadline start
+ * there; the refresher wakes the loop once it has fetched. */
+static SCHEDULER_ENTRY time_t scheduler_step(LaunchBatch *batch, time_t now, time_t *status_logged_at) {
+    CarbonSnapshot carbon[MAX_REGIONS];
+    carbon_snapshot_read_all(carbon);
+    unsigned fresh = carbon_fresh_mask(carbon, now);
+    time_t next = preempt_pass();   /* resumes suspended tasks whose deadline arrived */
+    int released = scheduler_pass(batch);
+
+    tasks_lock_acquire();
+    time_t due = pending_next_due(now, fresh);
+    if (due > 0 && (next == 0 || due < next)) next = due;
+    int backlog = pending_total();
+    if (backlog > 0 && now - *status_logged_at >= POLL_INTERVAL) {
+        *status_logged_at = now;
+        int planned = 0, deferring = 0;
+        for (int i = 0; i < carbon_region_count; ++i) {
+            planned += forecast_plan_live(i, now) != NULL;
+            deferring += carbon_is_high(&carbon[i]);
+        }
+        if (planned > 0)
+            log_msg("[INFO] Waiting for planned forecast slots: %d tasks pending (%d released)\n", backlog, released);
+        else if (deferring > 0)
+            log_msg("[INFO] Deferred due to high carbon in %d of %d regions: %d tasks pending (%d released)\n",
+                    deferring, carbon_region_count, backlog, released);
+        for (int r = 0; r < URGENCY_COUNT; ++r) {
+            int waiting = 0;
+            for (int g = 0; g < PENDING_GROUPS; ++g) waiting += pending[g][r].count;
+            if (waiting > 0 && task_running[r] >= (int)max_running[r])
+                log_msg("[INFO] Admission capped: %s %d/%u running, %d waiting\n",
+                        urgency_name(r), task_running[r], max_running[r], waiting);
+        }
+    }
+    tasks_lock_release();
+    return next;
+}
+
+/* background refresher: wakes when the first region's reading is due (carbon_next_fetch)
+ * and runs a carbon_fetch_round for every region due by then. with no live tasks it does
+ * not fetch at all and sleeps until carbon_kick(). after each round it applies any
+ * preemption change and wakes the scheduler loop. */
+static void carbon_kick(void) {
+    pthread_mutex_lock(&carbon_wait_lock);
+    pthread_cond_broadcast(&carbon_wait_cond);
+    pthread_mutex_unlock(&carbon_wait_lock);
+}
+
+static SCHEDULER_ENTRY void* carbon_refresher(void *arg) {
+    CURLM *multi = (CURLM *)arg;
+    while (!exit_requested) {
+        time_t next = 0;
+        for (int i = 0; i < carbon_region_count; ++i) {
+            CarbonSnapshot cur;
+            carbon_snapshot_read(i, &cur);
+            time_t at = carbon_next_fetch(i, &cur);
+            if (i == 0 || at < next) next = at;
+        }
+        struct timespec until = { next, 0 };
+        pthread_mutex_lock(&carbon_wait_lock);
+        while (!exit_requested) {
+            int idle = __atomic_load_n(&task_live, __ATOMIC_RELAXED) == 0;
+            if (!idle && clock_now() >= next) break;
+            if (idle) pthread_cond_wait(&carbon_wait_cond, &carbon_wait_lock);
+            else pthread_cond_timedwait(&carbon_wait_cond, &carbon_wait_lock, &until);
+        }
+        pthread_mutex_unlock(&carbon_wait_lock);
+        if (exit_requested) break;
+        carbon_fetch_round(multi);
+        preempt_pass();
+        sched_wake();
+    }
+    return NULL;
+}
+
+/* reap one exited child and complete its task; returns 1 if it was a tracked task */
+static int reap_child(pid_t pid) {
+    int status;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) != pid) return 0;
+    time_t end = clock_now();
+    tasks_lock_acquire();
+    int i = pid_map_take(pid);
+    if (i >= 0) task_complete(i, pid, end, status, &ru);
+    tasks_lock_release();
+    return i >= 0;
+}
+
+/* poll the children that have no pidfd; returns how many completed */
+static int reap_unwatched_poll(void) {
+    int done = 0, status;
+    struct rusage ru;
+    time_t end = clock_now();
+    tasks_lock_acquire();
+    for (int k = 0; k < reap_unwatched_count; ) {
+        pid_t pid = reap_unwatched[k];
+        if (wait4(pid, &status, WNOHANG, &ru) != pid) { k++; continue; }
+        reap_unwatched[k] = reap_unwatched[reap_unwatched_count - 1];
+        __atomic_store_n(&reap_unwatched_count, reap_unwatched_count - 1, __ATOMIC_RELAXED);
+        int i = pid_map_take(pid);
+        if (i >= 0) { task_complete(i, pid, end, status, &ru); done++; }
+    }
+    tasks_lock_release();
+    return done;
+}
+
+/* watcher thread: sleeps in epoll_wait until a child's pidfd (or the shutdown eventfd)
+ * becomes readable, logs the completion and wakes the scheduler loop */
+static SCHEDULER_ENTRY void* task_completion_watcher(void *arg) {
+    (void)arg;
+    struct epoll_event events[64];
+    while (!exit_requested) {
+        int timeout = __atomic_load_n(&reap_unwatched_count, __ATOMIC_RELAXED) > 0 ? REAP_FALLBACK_MS : -1;
+        int n = epoll_wait(reap_epoll_fd, events, 64, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log_msg("[ERROR] Completion watcher epoll_wait failed: %s\n", strerror(errno));
+            break;
+        }
+        int completed = 0;
+        for (int k = 0; k < n; ++k) {
+            if (events[k].data.u64 == 0) continue;   /* shutdown wake-up; loop re-checks the flag */
+            pid_t pid = (pid_t)(uint32_t)events[k].data.u64;
+            close((int)(events[k].data.u64 >> 32));  /* also drops it from the epoll set */
+            completed += reap_child(pid);
+        }
+        if (timeout >= 0) completed += reap_unwatched_poll();
+        /* finished children freed slots in their classes: let the loop admit the next ones */
+        if (completed > 0) sched_wake();
+    }
+    return NULL;
+}
+
+/* GET /tasks read snapshots: the scheduler loop copies the hot fields of every live task
+ * (plus its command pointer) into an immutable TaskView under one tasks_lock hold and
+ * publishes it; HTTP threads only ever read the published view. readers register in one of
+ * two counters picked by the parity of task_view_epoch. after a new view is published, the
+ * old one is retired: the epoch is flipped once the previous parity has drained, and the
+ * old view (with the commands retired while it was current) is freed once the parity it
+ * was read under drains too. a view is rebuilt only while someone is polling, at most every
+ * TASK_VIEW_MAX_AGE_MS, and dropped after TASK_VIEW_IDLE_MS without requests. */
+#define TASK_VIEW_MAX_AGE_MS 500
+#define TASK_VIEW_IDLE_MS 10000
+#define TASK_VIEW_PAGE_DEFAULT 100
+#define TASK_VIEW_PAGE_MAX 1000
+#define TASK_VIEW_CHUNK 16384
+
+enum { VIEW_PENDING, VIEW_RUNNING, VIEW_SUSPENDED, VIEW_STATES };
+static const char *const view_state_names[VIEW_STATES] = { "pending", "running", "suspended" };
+
+typedef struct TaskViewEntry {
+    uint32_t slot;
+    uint32_t gen;
+    const char *command;
     time_t submitted_at;
     time_t deadline;
+    time_t started_at;
     pid_t pid;
-    int started;
-    int delayed;
-} Task;
+    uint8_t state;
+    uint8_t urgency;
+    uint8_t delayed;
+    uint8_t region;     /* requested region while pending, else the one it runs in */
+} TaskViewEntry;
 
-struct MemoryStruct { char *memory; size_t size; };
+typedef struct TaskView {
+    int64_t fresh_ms;    /* last time the view was known to match the queue (loop updates it in place) */
+    unsigned version;
+    int count;
+    TaskViewEntry *entries;                           /* ascending slot */
+    uint32_t *lists[VIEW_STATES][URGENCY_COUNT];      /* entry indices per (state, urgency) */
+    int list_count[VIEW_STATES][URGENCY_COUNT];
+    char **limbo;                                     /* commands to free along with the view */
+    int limbo_count;
+} TaskView;
 
-static Task *tasks = NULL;
-static int task_count = 0;
-static int task_capacity = 0;
-static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static TaskView *task_view_current = NULL;
+static TaskView *task_view_retired = NULL;   /* scheduler loop only */
+static int task_view_flipped = 0;            /* scheduler loop only */
+static uint64_t task_view_epoch = 0;
+static uint64_t task_view_readers[2];
+static int64_t task_view_requested_ms = 0;
+static int64_t task_view_woken_ms = 0;
+static pthread_mutex_t task_view_wait_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t task_view_wait_cond = PTHREAD_COND_INITIALIZER;
 
-static int completed_tasks = 0;
-static double total_delay_seconds = 0.0;
+static void task_view_free(TaskView *v) {
+    if (!v) return;
+    for (int i = 0; i < v->limbo_count; ++i) task_string_free(v->limbo[i]);
+    free(v->limbo);
+    for (int s = 0; s < VIEW_STATES; ++s)
+        for (int r = 0; r < URGENCY_COUNT; ++r) free(v->lists[s][r]);
+    free(v->entries);
+    free(v);
+}
 
-static FILE *logfp_global = NULL;
-static int running_foreground = 0;
-static volatile sig_atomic_t exit_requested = 0;
+/* the current view for the duration of a request; pass *epoch to task_view_exit */
+static const TaskView *task_view_enter(uint64_t *epoch) {
+    for (;;) {
+        uint64_t e = __atomic_load_n(&task_view_epoch, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&task_view_readers[e & 1], 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&task_view_epoch, __ATOMIC_SEQ_CST) == e) { *epoch = e; break; }
+        __atomic_fetch_sub(&task_view_readers[e & 1], 1, __ATOMIC_SEQ_CST);
+    }
+    return __atomic_load_n(&task_view_current, __ATOMIC_SEQ_CST);
+}
+
+static void task_view_exit(uint64_t epoch) { __atomic_fetch_sub(&task_view_readers[epoch & 1], 1, __ATOMIC_SEQ_CST); }
 
-/* helper: timestamp prefix for logs */
-static void timestamp_log(FILE *logfp) {
-    time_t now = time(NULL);
-    char timebuf[64];
-    struct tm t;
-    localtime_r(&now, &t);
-    strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", &t);
-    fprintf(logfp, "[%s] ", timebuf);
+/* note the request, and wake the scheduler loop (at most twice per refresh period) if the
+ * view is missing or due for a rebuild */
+static void task_view_request(const TaskView *v) {
+    int64_t now = now_ms();
+    __atomic_store_n(&task_view_requested_ms, now, __ATOMIC_RELAXED);
+    if (v && now - __atomic_load_n(&v->fresh_ms, __ATOMIC_RELAXED) < TASK_VIEW_MAX_AGE_MS) return;
+    int64_t woken = __atomic_load_n(&task_view_woken_ms, __ATOMIC_RELAXED);
+    if (v && now - woken < TASK_VIEW_MAX_AGE_MS / 2) return;
+    if (__atomic_compare_exchange_n(&task_view_woken_ms, &woken, now, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) sched_wake();
 }
 
-/* curl write callback */
-static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb;
-    struct MemoryStruct *mem = (struct MemoryStruct *)userp;
-    char *ptr = realloc(mem->memory, mem->size + realsize + 1);
-    if (!ptr) return 0;
-    mem->memory = ptr;
-    memcpy(&(mem->memory[mem->size]), contents, realsize);
-    mem->size += realsize;
-    mem->memory[mem->size] = 0;
-    return realsize;
+/* enter a view, waiting up to a second for the first one to be built */
+static const TaskView *task_view_acquire(uint64_t *epoch) {
+    const TaskView *v = task_view_enter(epoch);
+    task_view_request(v);
+    if (v) return v;
+    task_view_exit(*epoch);
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += 1;
+    pthread_mutex_lock(&task_view_wait_lock);
+    while (!__atomic_load_n(&task_view_current, __ATOMIC_SEQ_CST))
+        if (pthread_cond_timedwait(&task_view_wait_cond, &task_view_wait_lock, &until) != 0) break;
+    pthread_mutex_unlock(&task_view_wait_lock);
+    return task_view_enter(epoch);
 }
 
-/* fetch carbon intensity index (returns strdup'd string that caller must free) */
-static char* fetch_carbon_index_with_curl() {
-    CURL *curl = curl_easy_init();
-    if (!curl) return NULL;
-    struct MemoryStruct chunk = {0};
-    chunk.memory = malloc(1);
-    chunk.size = 0;
-    curl_easy_setopt(curl, CURLOPT_URL, CARBON_API_URL);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        if (logfp_global) { timestamp_log(logfp_global); fprintf(logfp_global, "[ERROR] Carbon API request failed: %s\n", curl_easy_strerror(res)); fflush(logfp_global); }
-        free(chunk.memory);
-        curl_easy_cleanup(curl);
+/* free the retired view once no reader can hold it; scheduler loop only */
+static void task_view_reclaim(void) {
+    if (!task_view_retired) return;
+    uint64_t e = __atomic_load_n(&task_view_epoch, __ATOMIC_SEQ_CST);
+    if (!task_view_flipped) {
+        if (__atomic_load_n(&task_view_readers[(e + 1) & 1], __ATOMIC_SEQ_CST) != 0) return;
+        __atomic_store_n(&task_view_epoch, ++e, __ATOMIC_SEQ_CST);
+        task_view_flipped = 1;
+    }
+    if (__atomic_load_n(&task_view_readers[(e + 1) & 1], __ATOMIC_SEQ_CST) != 0) return;
+    task_view_free(task_view_retired);
+    task_view_retired = NULL;
+}
+
+static void task_view_publish(TaskView *next, char **limbo, int limbo_count) {
+    TaskView *old = task_view_current;
+    if (old) { old->limbo = limbo; old->limbo_count = limbo_count; }
+    else { for (int i = 0; i < limbo_count; ++i) task_string_free(limbo[i]); free(limbo); }
+    pthread_mutex_lock(&task_view_wait_lock);
+    __atomic_store_n(&task_view_current, next, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&task_view_wait_cond);
+    pthread_mutex_unlock(&task_view_wait_lock);
+    task_view_retired = old;
+    task_view_flipped = 0;
+    task_view_reclaim();
+}
+
+/* copy the live tasks in chunks of TASK_VIEW_CHUNK slots, one short tasks_lock hold each, so
+ * a large queue never blocks ingest for the whole copy; then index them by (state, urgency)
+ * without the lock. each slot is copied once, so the view is consistent per task, not a
+ * single instant. the limbo taken at the start holds only commands retired before any copy;
+ * commands retired during the copy stay in limbo until the view after this one is built.
+ * NULL (and the current view marked fresh) if nothing changed since it was built. */
+static TaskView *task_view_build(char ***limbo, int *limbo_count) {
+    tasks_lock_acquire();
+    if (task_view_current && task_view_current->version == task_version) {
+        tasks_lock_release();
+        __atomic_store_n(&task_view_current->fresh_ms, now_ms(), __ATOMIC_RELAXED);
         return NULL;
     }
-    struct json_object *root = json_tokener_parse(chunk.memory);
-    free(chunk.memory);
-    if (!root) { curl_easy_cleanup(curl); return NULL; }
-    struct json_object *data_array = NULL;
-    if (!json_object_object_get_ex(root, "data", &data_array)) { json_object_put(root); curl_easy_cleanup(curl); return NULL; }
-    struct json_object *first_entry = json_object_array_get_idx(data_array, 0);
-    if (!first_entry) { json_object_put(root); curl_easy_cleanup(curl); return NULL; }
-    struct json_object *intensity_obj = NULL;
-    if (!json_object_object_get_ex(first_entry, "intensity", &intensity_obj)) { json_object_put(root); curl_easy_cleanup(curl); return NULL; }
-    struct json_object *index_obj = NULL, *forecast_obj = NULL;
-    json_object_object_get_ex(intensity_obj, "index", &index_obj);
-    json_object_object_get_ex(intensity_obj, "forecast", &forecast_obj);
-    const char *index = index_obj ? json_object_get_string(index_obj) : NULL;
-    int forecast = forecast_obj ? json_object_get_int(forecast_obj) : -1;
-    if (logfp_global) { timestamp_log(logfp_global); fprintf(logfp_global, "[INFO] Carbon Intensity Level: %s | Forecast: %d gCO2/kWh\n", index ? index : "unknown", forecast); fflush(logfp_global); }
-    char *result = index ? strdup(index) : NULL;
-    json_object_put(root);
-    curl_easy_cleanup(curl);
-    return result;
+    TaskView *v = calloc(1, sizeof(TaskView));
+    v->version = task_version;
+    v->fresh_ms = now_ms();
+    *limbo = task_limbo; *limbo_count = task_limbo_count;
+    task_limbo = NULL; task_limbo_count = task_limbo_capacity = 0;
+    task_view_active = 1;
+    int capacity = task_live > 0 ? task_live : 1;
+    v->entries = malloc(sizeof(TaskViewEntry) * capacity);
+    for (int next = 0;;) {
+        int end = next + TASK_VIEW_CHUNK < task_count ? next + TASK_VIEW_CHUNK : task_count;
+        for (int i = next; i < end; ++i) {
+            const TaskHot *h = &task_hot[i];
+            if (h->state == TASK_FREE) continue;
+            const TaskCold *c = &task_cold[i];
+            if (v->count == capacity) { capacity *= 2; v->entries = realloc(v->entries, sizeof(TaskViewEntry) * capacity); }
+            TaskViewEntry *e = &v->entries[v->count++];
+            e->slot = (uint32_t)i;
+            e->gen = c->gen;
+            e->command = c->command;
+            e->submitted_at = c->submitted_at;
+            e->deadline = h->deadline;
+            e->started_at = h->state == TASK_PENDING ? 0 : c->started_at;
+            e->pid = h->pid;
+            e->state = h->state == TASK_PENDING ? VIEW_PENDING : h->state == TASK_SUSPENDED ? VIEW_SUSPENDED : VIEW_RUNNING;
+            e->urgency = h->urgency;
+            e->delayed = h->delayed;
+            e->region = (uint8_t)(h->state == TASK_PENDING ? c->region : h->region);
+        }
+        next = end;
+        if (next >= task_count) break;
+        tasks_lock_release();   /* let ingest and the loop in between chunks */
+        tasks_lock_acquire();
+    }
+    tasks_lock_release();
+    for (int i = 0; i < v->count; ++i) v->list_count[v->entries[i].state][v->entries[i].urgency]++;
+    for (int s = 0; s < VIEW_STATES; ++s)
+        for (int r = 0; r < URGENCY_COUNT; ++r) { v->lists[s][r] = malloc(sizeof(uint32_t) * (v->list_count[s][r] + 1)); v->list_count[s][r] = 0; }
+    for (int i = 0; i < v->count; ++i) {
+        const TaskViewEntry *e = &v->entries[i];
+        v->lists[e->state][e->urgency][v->list_count[e->state][e->urgency]++] = (uint32_t)i;
+    }
+    return v;
 }
 
-/* dynamic task array helpers */
-static void tasks_ensure_capacity(int need) {
-    if (task_capacity >= need) return;
-    int newcap = (task_capacity > 0) ? task_capacity * 2 : MAX_TASKS_INCREMENT;
-    while (newcap < need) newcap *= 2;
-    tasks = realloc(tasks, sizeof(Task) * newcap);
-    for (int i = task_capacity; i < newcap; ++i) {
-        tasks[i].command = NULL; tasks[i].urgency = NULL; tasks[i].started = 0; tasks[i].delayed = 0; tasks[i].pid = 0;
+/* scheduler loop hook: reclaim, rebuild or drop the view. returns when it wants to run
+ * again (0: not before the next wake-up). */
+static SCHEDULER_ENTRY time_t task_view_maintain(time_t now) {
+    task_view_reclaim();
+    int64_t ms = now_ms();
+    int64_t requested = __atomic_load_n(&task_view_requested_ms, __ATOMIC_RELAXED);
+    if (!task_view_retired) {
+        if (task_view_current && ms - requested > TASK_VIEW_IDLE_MS) {
+            tasks_lock_acquire();
+            char **limbo = task_limbo;
+            int limbo_count = task_limbo_count;
+            task_limbo = NULL; task_limbo_count = task_limbo_capacity = 0;
+            task_view_active = 0;
+            tasks_lock_release();
+            task_view_publish(NULL, limbo, limbo_count);
+        } else if (ms - requested <= TASK_VIEW_IDLE_MS &&
+                   (!task_view_current || ms - task_view_current->fresh_ms >= TASK_VIEW_MAX_AGE_MS)) {
+            char **limbo = NULL;
+            int limbo_count = 0;
+            TaskView *v = task_view_build(&limbo, &limbo_count);
+            if (v) task_view_publish(v, limbo, limbo_count);
+        }
     }
-    task_capacity = newcap;
+    if (task_view_retired) return now + 1;
+    return task_view_current ? (time_t)((requested + TASK_VIEW_IDLE_MS) / 1000) + 1 : 0;
+}
+
+static uint64_t task_view_id(const TaskViewEntry *e) { return (uint64_t)e->gen << 32 | e->slot; }
+
+static struct json_object *task_view_json(const TaskViewEntry *e) {
+    struct json_object *o = json_object_new_object();
+    json_object_object_add(o, "id", json_object_new_int64((int64_t)task_view_id(e)));
+    json_object_object_add(o, "command", json_object_new_string(e->command));
+    json_object_object_add(o, "urgency", json_object_new_string(urgency_name(e->urgency)));
+    json_object_object_add(o, "region", json_object_new_string(region_name(e->region)));
+    json_object_object_add(o, "state", json_object_new_string(view_state_names[e->state]));
+    json_object_object_add(o, "delayed", json_object_new_boolean(e->delayed));
+    json_object_object_add(o, "pid", json_object_new_int(e->pid));
+    json_object_object_add(o, "submitted_at", json_object_new_int64(e->submitted_at));
+    json_object_object_add(o, "deadline", json_object_new_int64(e->deadline));
+    json_object_object_add(o, "started_at", e->started_at ? json_object_new_int64(e->started_at) : NULL);
+    return o;
+}
+
+/* first position in list whose entry slot is >= slot */
+static int task_view_lower_bound(const TaskView *v, const uint32_t *list, int n, uint32_t slot) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (v->entries[list[mid]].slot < slot) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+/* one page of tasks in slot order, starting at slot cursor, matching the state and urgency
+ * masks: a merge over the matching (state, urgency) lists, each entered by binary search */
+static struct json_object *task_view_page(const TaskView *v, unsigned state_mask, unsigned urgency_mask,
+                                          uint32_t cursor, int limit) {
+    const uint32_t *lists[VIEW_STATES * URGENCY_COUNT];
+    int pos[VIEW_STATES * URGENCY_COUNT], ends[VIEW_STATES * URGENCY_COUNT], n = 0;
+    int64_t total = 0;
+    for (int s = 0; s < VIEW_STATES; ++s)
+        for (int r = 0; r < URGENCY_COUNT; ++r) {
+            if (!(state_mask & (1u << s)) || !(urgency_mask & (1u << r))) continue;
+            lists[n] = v->lists[s][r];
+            ends[n] = v->list_count[s][r];
+            pos[n] = task_view_lower_bound(v, lists[n], ends[n], cursor);
+            total += ends[n];
+            n++;
+        }
+    struct json_object *tasks = json_object_new_array();
+    const TaskViewEntry *last = NULL;
+    int more = 0;
+    for (int k = 0; ; ++k) {
+        int best = -1;
+        for (int i = 0; i < n; ++i)
+            if (pos[i] < ends[i] && (best < 0 || lists[i][pos[i]] < lists[best][pos[best]])) best = i;
+        if (best < 0) break;
+        if (k == limit) { more = 1; break; }
+        last = &v->entries[lists[best][pos[best]++]];
+        json_object_array_add(tasks, task_view_json(last));
+    }
+    struct json_object *root = json_object_new_object();
+    json_object_object_add(root, "tasks", tasks);
+    json_object_object_add(root, "total", json_object_new_int64(total));
+    json_object_object_add(root, "next_cursor", more ? json_object_new_int64((int64_t)last->slot + 1) : NULL);
+    json_object_object_add(root, "snapshot_age_ms", json_object_new_int64(now_ms() - __atomic_load_n(&v->fresh_ms, __ATOMIC_RELAXED)));
+    return root;
+}
+
+static const TaskViewEntry *task_view_find(const TaskView *v, uint64_t id) {
+    uint32_t slot = (uint32_t)id;
+    int lo = 0, hi = v->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (v->entries[mid].slot < slot) lo = mid + 1; else hi = mid;
+    }
+    if (lo < v->count && v->entries[lo].slot == slot && v->entries[lo].gen == (uint32_t)(id >> 32)) return &v->entries[lo];
+    return NULL;
+}
+
+/* streaming /add_tasks ingest: the body is split into top-level array elements as chunks
+ * arrive, and each element is parsed and staged as soon as it closes, so the raw body is
+ * never buffered and an element's text is capped at MAX_TASK_JSON. a batch is all or
+ * nothing, though: every staged task (its compiled command and StagedTask) stays in the
+ * request arena until ingest_drain applies the batch, so peak memory is still O(request). */
+#define MAX_TASK_JSON 65536
+
+typedef struct StagedTask { char *command; Urgency urgency; int deadline_hours; time_t submitted_at; int region; } StagedTask;
+typedef struct StagedList { StagedTask *items; int count; int capacity; } StagedList;
+
+enum { INGEST_START, INGEST_FIRST_ELEM, INGEST_ELEM, INGEST_IN_ELEM, INGEST_AFTER_ELEM, INGEST_DONE, INGEST_ERROR,
+       INGEST_QUEUED, INGEST_ACKED, INGEST_REFUSED };
+
+struct http_cb_ctx {
+    Arena arena;                             /* holds the ctx itself and everything staged */
+    int state;
+    int depth, in_string, escape;
+    char *elem; size_t elem_len, elem_cap;   /* text of the element being read */
+    StagedList staged[URGENCY_COUNT];        /* by urgency, so the batch stays stable */
+    int count;
+    const char *error;
+    uint64_t started_us;   /* first callback of the request */
+    struct http_cb_ctx *ingest_next;   /* ingest queue link */
+    struct MHD_Connection *connection; /* suspended while queued; NULL outside the HTTP server */
+};
+
+static struct http_cb_ctx *http_cb_ctx_new(void) {
+    Arena arena = { NULL, 0 };
+    struct http_cb_ctx *ctx = arena_alloc(&arena, sizeof(struct http_cb_ctx));
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->arena = arena;
+    return ctx;
+}
+
+static void staged_list_push(struct http_cb_ctx *ctx, StagedList *l, StagedTask t) {
+    if (l->count == l->capacity) {
+        int old = l->capacity;
+        l->capacity = l->capacity ? l->capacity * 2 : MAX_TASKS_INCREMENT;
+        l->items = arena_grow(&ctx->arena, l->items, sizeof(StagedTask) * old, sizeof(StagedTask) * l->capacity);
+    }
+    l->items[l->count++] = t;
+}
+
+static void http_cb_ctx_free(struct http_cb_ctx *ctx) {
+    Arena arena = ctx->arena;
+    arena_free(&arena);
+}
+
+static void ingest_fail(struct http_cb_ctx *ctx, const char *error) { ctx->state = INGEST_ERROR; ctx->error = error; }
+
+static void ingest_elem_append(struct http_cb_ctx *ctx, const char *data, size_t n) {
+    if (ctx->elem_len + n + 1 > MAX_TASK_JSON) { ingest_fail(ctx, "Task object too large"); return; }
+    if (ctx->elem_len + n + 1 > ctx->elem_cap) {
+        size_t old = ctx->elem_cap;
+        while (ctx->elem_len + n + 1 > ctx->elem_cap) ctx->elem_cap = ctx->elem_cap ? ctx->elem_cap * 2 : 256;
+        ctx->elem = arena_grow(&ctx->arena, ctx->elem, old, ctx->elem_cap);
+    }
+    memcpy(ctx->elem + ctx->elem_len, data, n);
+    ctx->elem_len += n;
+}
+
+/* task objects are flat, so an element is read field by field straight from its text rather
+ * than through a json-c tree, which costs a dozen or more mallocs per task. strings are
+ * decoded in place (never longer than their source) and NUL-terminated there, so they stay
+ * valid until the next element is read. values are coerced as json-c would: the integer
+ * fields take numbers (truncated), numeric strings and booleans, anything else reads as 0. */
+#define JSON_SCAN_DEPTH 32
+
+typedef struct JsonScan { char *p, *end; } JsonScan;
+
+static void json_scan_ws(JsonScan *s) {
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' || *s->p == '\r')) s->p++;
+}
+
+static int json_scan_char(JsonScan *s, char c) {
+    json_scan_ws(s);
+    if (s->p == s->end || *s->p != c) return 0;
+    s->p++;
+    json_scan_ws(s);
+    return 1;
 }
 
-static int tasks_append(Task t) { tasks_ensure_capacity(task_count + 1); tasks[task_count] = t; return task_count++; }
+static int json_scan_hex4(const char *p, unsigned *out) {
+    unsigned v = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') v |= (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') v |= (unsigned)(c - 'A' + 10);
+        else return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+/* the string at s->p, decoded in place; NULL if malformed */
+static char *json_scan_string(JsonScan *s, size_t *len) {
+    if (s->p == s->end || *s->p != '"') return NULL;
+    char *out = ++s->p, *q = out, *w = out;
+    for (;;) {
+        if (q == s->end) return NULL;
+        char c = *q++;
+        if (c == '"') break;
+        if (c != '\\') { *w++ = c; continue; }
+        if (q == s->end) return NULL;
+        switch (c = *q++) {
+        case '"': case '\\': case '/': *w++ = c; break;
+        case 'b': *w++ = '\b'; break;
+        case 'f': *w++ = '\f'; break;
+        case 'n': *w++ = '\n'; break;
+        case 'r': *w++ = '\r'; break;
+        case 't': *w++ = '\t'; break;
+        case 'u': {
+            unsigned cp, lo;
+            if (s->end - q < 4 || !json_scan_hex4(q, &cp)) return NULL;
+            q += 4;
+            if (cp >= 0xD800 && cp < 0xDC00 && s->end - q >= 6 && q[0] == '\\' && q[1] == 'u' &&
+                json_scan_hex4(q + 2, &lo) && lo >= 0xDC00 && lo < 0xE000) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                q += 6;
+            } else if (cp >= 0xD800 && cp < 0xE000) cp = 0xFFFD;   /* unpaired surrogate */
+            if (cp < 0x80) *w++ = (char)cp;
+            else if (cp < 0x800) { *w++ = (char)(0xC0 | cp >> 6); *w++ = (char)(0x80 | (cp & 0x3F)); }
+            else if (cp < 0x10000) { *w++ = (char)(0xE0 | cp >> 12); *w++ = (char)(0x80 | (cp >> 6 & 0x3F)); *w++ = (char)(0x80 | (cp & 0x3F)); }
+            else { *w++ = (char)(0xF0 | cp >> 18); *w++ = (char)(0x80 | (cp >> 12 & 0x3F)); *w++ = (char)(0x80 | (cp >> 6 & 0x3F)); *w++ = (char)(0x80 | (cp & 0x3F)); }
+            break;
+        }
+        default: return NULL;
+        }
+    }
+    *w = 0;
+    *len = (size_t)(w - out);
+    s->p = q;
+    return out;
+}
 
-static int tasks_contains(const char *command, time_t submitted_at) {
-    for (int i = 0; i < task_count; ++i)
-        if (tasks[i].command && strcmp(tasks[i].command, command) == 0 && tasks[i].submitted_at == submitted_at) return 1;
+/* step over one value of any type; 0, or -1 if malformed */
+static int json_scan_skip(JsonScan *s, int depth) {
+    json_scan_ws(s);
+    if (s->p == s->end || depth > JSON_SCAN_DEPTH) return -1;
+    size_t len;
+    char c = *s->p;
+    if (c == '"') return json_scan_string(s, &len) ? 0 : -1;
+    if (c == '{' || c == '[') {
+        char close = c == '{' ? '}' : ']';
+        s->p++;
+        if (json_scan_char(s, close)) return 0;
+        do {
+            if (c == '{' && (!json_scan_string(s, &len) || !json_scan_char(s, ':'))) return -1;
+            if (json_scan_skip(s, depth + 1) != 0) return -1;
+        } while (json_scan_char(s, ','));
+        return json_scan_char(s, close) ? 0 : -1;
+    }
+    const char *literals[3] = { "true", "false", "null" };
+    for (int i = 0; i < 3; ++i) {
+        len = strlen(literals[i]);
+        if ((size_t)(s->end - s->p) >= len && memcmp(s->p, literals[i], len) == 0) { s->p += len; return 0; }
+    }
+    /* -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? */
+    char *q = s->p;
+    if (q < s->end && *q == '-') q++;
+    if (q < s->end && *q == '0') q++;
+    else if (q < s->end && *q >= '1' && *q <= '9') while (q < s->end && isdigit((unsigned char)*q)) q++;
+    else return -1;
+    if (q < s->end && *q == '.') {
+        if (++q == s->end || !isdigit((unsigned char)*q)) return -1;
+        while (q < s->end && isdigit((unsigned char)*q)) q++;
+    }
+    if (q < s->end && (*q == 'e' || *q == 'E')) {
+        if (++q < s->end && (*q == '+' || *q == '-')) q++;
+        if (q == s->end || !isdigit((unsigned char)*q)) return -1;
+        while (q < s->end && isdigit((unsigned char)*q)) q++;
+    }
+    s->p = q;
     return 0;
 }
 
-/* launch a task */
-static void run_task(Task *task) {
-    pid_t pid = fork();
-    if (pid < 0) return;
-    if (pid == 0) {
-        if (task->urgency && strcmp(task->urgency, "low") == 0) nice(10);
-        char *cmdcopy = strdup(task->command);
-        char *args[64];
-        int idx = 0;
-        char *tok = strtok(cmdcopy, " ");
-        while (tok && idx < 63) { args[idx++] = tok; tok = strtok(NULL, " "); }
-        args[idx] = NULL;
-        execvp(args[0], args);
-        _exit(127);
-    } else {
-        task->pid = pid;
-        task->started = 1;
-        timestamp_log(logfp_global);
-        fprintf(logfp_global, "[TASK] Launched: %s | PID: %d | Delayed: %s\n", task->command, pid, task->delayed ? "yes" : "no");
-        fflush(logfp_global);
+/* an integer field, coerced as above; 0, or -1 if malformed */
+static int json_scan_int(JsonScan *s, int64_t *out) {
+    json_scan_ws(s);
+    char *start = s->p;
+    size_t len;
+    if (s->p < s->end && *s->p == '"') {
+        char *str = json_scan_string(s, &len);
+        if (!str) return -1;
+        *out = strtoll(str, NULL, 10);
+        return 0;
     }
+    if (json_scan_skip(s, 0) != 0) return -1;
+    *out = *start == 't';
+    if (*start != '-' && !isdigit((unsigned char)*start)) return 0;
+    char saved = *s->p;   /* a value is always followed by at least the closing brace */
+    *s->p = 0;
+    if (strpbrk(start, ".eE")) {
+        double d = strtod(start, NULL);
+        *out = d >= 9e18 ? INT64_MAX : d <= -9e18 ? INT64_MIN : (int64_t)d;
+    } else *out = strtoll(start, NULL, 10);
+    *s->p = saved;
+    return 0;
 }
 
-/* blocking watcher thread that waits for any child to exit and logs immediately */
-static void* task_completion_watcher(void *arg) {
-    int status;
-    pid_t pid;
-    while (!exit_requested) {
-        pid = waitpid(-1, &status, 0); /* block until a child changes state */
-        if (pid > 0) {
-            pthread_mutex_lock(&tasks_lock);
-            for (int i = 0; i < task_count; ++i) {
-                if (tasks[i].pid == pid) {
-                    time_t end = time(NULL);
-                    double delay = difftime(end, tasks[i].submitted_at);
-                    total_delay_seconds += delay;
-                    completed_tasks++;
-                    timestamp_log(logfp_global);
-                    fprintf(logfp_global, "[TASK] Completed: %s | PID: %d | Delay: %.0f sec\n",
-                            tasks[i].command, pid, delay);
-                    fflush(logfp_global);
-                    break;
-                }
-            }
-            pthread_mutex_unlock(&tasks_lock);
-        } else {
-            /* waitpid returned <=0: if interrupted or no children, loop; check exit flag */
-            if (pid == -1 && errno == ECHILD) {
-                /* no children at the moment; sleep briefly */
-                sleep(1);
-            } else if (pid == -1 && errno == EINTR) {
-                continue;
-            } else {
-                /* other errors -> short sleep to avoid busy-loop */
-                usleep(200000);
+/* turn one complete array element into a staged task */
+static void ingest_element(struct http_cb_ctx *ctx) {
+    JsonScan s = { ctx->elem, ctx->elem + ctx->elem_len };
+    ctx->elem_len = 0;
+    char *cmd = NULL, *urg = NULL, *reg = NULL;
+    size_t cmd_len = 0, len;
+    char **args = NULL;
+    size_t *arg_lens = NULL;
+    int has_cmd = 0, has_argv = 0, argc = 0, argv_ok = 0, has_submitted = 0;
+    int64_t deadline = 0, submitted = 0;
+    int ok = json_scan_char(&s, '{');
+    if (ok && !json_scan_char(&s, '}')) {
+        do {
+            char *key = json_scan_string(&s, &len);
+            if (!key || !json_scan_char(&s, ':')) { ok = 0; break; }
+            int string_value = s.p < s.end && *s.p == '"';
+            if (strcmp(key, "command") == 0) {
+                has_cmd = 1;
+                cmd = string_value ? json_scan_string(&s, &cmd_len) : NULL;
+                ok = string_value ? cmd != NULL : json_scan_skip(&s, 0) == 0;
+            } else if (strcmp(key, "urgency") == 0) {
+                urg = string_value ? json_scan_string(&s, &len) : NULL;
+                ok = string_value ? urg != NULL : json_scan_skip(&s, 0) == 0;
+            } else if (strcmp(key, "region") == 0) {
+                reg = string_value ? json_scan_string(&s, &len) : NULL;
+                ok = string_value ? reg != NULL : json_scan_skip(&s, 0) == 0;
+            } else if (strcmp(key, "deadline_hours") == 0) ok = json_scan_int(&s, &deadline) == 0;
+            else if (strcmp(key, "submitted_at") == 0) { ok = json_scan_int(&s, &submitted) == 0; has_submitted = 1; }
+            else if (strcmp(key, "argv") == 0) {
+                has_argv = 1;
+                argc = 0;
+                argv_ok = s.p < s.end && *s.p == '[';
+                if (!argv_ok) { ok = json_scan_skip(&s, 0) == 0; continue; }
+                s.p++;
+                if (json_scan_char(&s, ']')) { argv_ok = 0; continue; }
+                int cap = 0;
+                do {
+                    if (s.p == s.end || *s.p != '"') {
+                        argv_ok = 0;
+                        if (json_scan_skip(&s, 1) != 0) { ok = 0; break; }
+                        continue;
+                    }
+                    if (argc == cap) {
+                        int old = cap;
+                        cap = cap ? cap * 2 : 16;
+                        args = arena_grow(&ctx->arena, args, sizeof(char *) * (size_t)old, sizeof(char *) * (size_t)cap);
+                        arg_lens = arena_grow(&ctx->arena, arg_lens, sizeof(size_t) * (size_t)old, sizeof(size_t) * (size_t)cap);
+                    }
+                    if (!(args[argc] = json_scan_string(&s, &arg_lens[argc]))) { ok = 0; break; }
+                    argc++;
+                } while (json_scan_char(&s, ','));
+                ok = ok && json_scan_char(&s, ']');
+            } else ok = json_scan_skip(&s, 0) == 0;
+        } while (ok && json_scan_char(&s, ','));
+        ok = ok && json_scan_char(&s, '}');
+    }
+    if (!ok || s.p != s.end) {
+        ingest_fail(ctx, "Expected JSON array of task objects");
+        return;
+    }
+    const char *error = "Task needs a command string or an argv array";
+    StagedTask t;
+    t.command = NULL;
+    if (has_cmd && has_argv) error = "Task has both command and argv";
+    else if (has_argv && !argv_ok) error = "argv must be a non-empty array of strings";
+    else if (has_argv) t.command = command_from_argv(args, arg_lens, argc, &ctx->arena, &error);
+    else if (cmd) t.command = command_compile(cmd, cmd_len, &ctx->arena, &error);
+    if (!t.command) {
+        ingest_fail(ctx, error);
+        return;
+    }
+    if ((t.region = region_lookup(reg)) < 0) {
+        ingest_fail(ctx, "Unknown region");
+        return;
+    }
+    t.urgency = parse_urgency(urg);
+    t.deadline_hours = deadline > INT_MAX ? INT_MAX : deadline < INT_MIN ? INT_MIN : (int)deadline;
+    t.submitted_at = has_submitted ? (time_t)submitted : clock_now();
+    staged_list_push(ctx, &ctx->staged[t.urgency], t);
+    ctx->count++;
+}
+
+/* feed one upload chunk through the element splitter */
+static void ingest_feed(struct http_cb_ctx *ctx, const char *data, size_t size) {
+    size_t i = 0;
+    while (i < size && ctx->state != INGEST_ERROR) {
+        char c = data[i];
+        if (ctx->state == INGEST_IN_ELEM) {
+            size_t begin = i;
+            for (; i < size; ++i) {
+                c = data[i];
+                if (ctx->in_string) {
+                    if (ctx->escape) ctx->escape = 0;
+                    else if (c == '\\') ctx->escape = 1;
+                    else if (c == '"') ctx->in_string = 0;
+                } else if (c == '"') ctx->in_string = 1;
+                else if (c == '{' || c == '[') ctx->depth++;
+                else if ((c == '}' || c == ']') && --ctx->depth == 0) break;
             }
+            if (i == size) { ingest_elem_append(ctx, data + begin, size - begin); break; }
+            ingest_elem_append(ctx, data + begin, i + 1 - begin);
+            ++i;
+            if (ctx->state == INGEST_ERROR) break;
+            ingest_element(ctx);
+            if (ctx->state != INGEST_ERROR) ctx->state = INGEST_AFTER_ELEM;
+            continue;
+        }
+        ++i;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') continue;
+        switch (ctx->state) {
+        case INGEST_START:
+            if (c == '[') ctx->state = INGEST_FIRST_ELEM; else ingest_fail(ctx, "Expected JSON array");
+            break;
+        case INGEST_FIRST_ELEM:
+            if (c == ']') { ctx->state = INGEST_DONE; break; }
+            /* fall through */
+        case INGEST_ELEM:
+            if (c != '{') { ingest_fail(ctx, "Expected JSON array of task objects"); break; }
+            ctx->state = INGEST_IN_ELEM; ctx->depth = 1; ctx->in_string = 0; ctx->escape = 0;
+            ingest_elem_append(ctx, "{", 1);
+            break;
+        case INGEST_AFTER_ELEM:
+            if (c == ',') ctx->state = INGEST_ELEM;
+            else if (c == ']') ctx->state = INGEST_DONE;
+            else ingest_fail(ctx, "Expected JSON array");
+            break;
+        default:
+            ingest_fail(ctx, "Trailing data after JSON array");
         }
     }
-    return NULL;
 }
 
-/* tiny no-op handler used to interrupt blocking waitpid on shutdown */
-static void noop_signal_handler(int sig) { (void)sig; }
+/* ingest hand-off: HTTP threads never touch the task structures. a parsed request's
+ * connection is suspended and the request pushed onto a lock-free MPSC stack (one CAS on
+ * ingest_head), and the thread goes back to its other connections. the scheduler loop takes
+ * every waiting request with a single exchange, applies them in arrival order under one
+ * tasks_lock hold and one journal group commit, then marks each INGEST_ACKED and resumes its
+ * connection, whose handler sends the reply. so a 200 still means "queued and durable", but
+ * no HTTP thread ever waits for the fsync. */
+#define INGEST_CLOSED ((struct http_cb_ctx *)1)
+
+static struct http_cb_ctx *ingest_head = NULL;
+
+/* apply one staged request to the pending queues, high urgency first, arrival order within a
+ * class. carbon is indexed by region; a reading that went stale while the daemon sat idle
+ * still decides whether a new task starts out deferred. caller holds tasks_lock; returns the
+ * number of tasks queued. */
+static int ingest_apply(struct http_cb_ctx *ctx, const CarbonSnapshot *carbon, uint64_t *lsn) {
+    int queued = 0;
+    for (int r = 0; r < URGENCY_COUNT; ++r) {
+        StagedList *l = &ctx->staged[r];
+        for (int i = 0; i < l->count; ++i) {
+            StagedTask *st = &l->items[i];
+            if (tasks_contains(st->command, st->submitted_at)) { counter_add(COUNTER_DUPLICATES, 1); continue; }
+            int idx = tasks_append(command_adopt(st->command), st->urgency, st->region, st->deadline_hours, st->submitted_at);
+            task_event(EVENT_SUBMITTED, idx, 0, 0);
+            *lsn = journal_append(JOURNAL_SUBMIT, idx);
+            pending_push(idx);
+            queued++;
+            time_t now = clock_now();
+            int group = pending_group(idx);
+            if (r == URGENCY_HIGH || pending_due(group, task_hot[idx].deadline, now, carbon, ~0u) >= 0) continue;
+            task_hot[idx].delayed = 1;
+            task_event(EVENT_DEFERRED, idx, 0, 0);
+            *lsn = journal_append(JOURNAL_DEFER, idx);
+            time_t start = pending_planned(group, task_hot[idx].deadline, now);
+            const char *region = region_name(task_cold[idx].region);
+            if (start > 0) {
+                struct tm tm;
+                char at[32];
+                strftime(at, sizeof(at), "%Y-%m-%d %H:%M", localtime_r(&start, &tm));
+                log_msg("[INFO] Received and planned for %s (forecast minimum): %s | urgency=%s | region=%s\n",
+                        at, task_cold[idx].command, urgency_name(r), region);
+            } else log_msg("[INFO] Received and delayed (high carbon): %s | urgency=%s | region=%s\n",
+                           task_cold[idx].command, urgency_name(r), region);
+        }
+    }
+    return queued;
+}
+
+/* request thread: queue ctx for the scheduler loop and return at once. ctx belongs to the
+ * loop until it sets INGEST_ACKED. -1 once the loop has shut the queue. */
+static int ingest_submit(struct http_cb_ctx *ctx) {
+    ctx->state = INGEST_QUEUED;
+    struct http_cb_ctx *head = __atomic_load_n(&ingest_head, __ATOMIC_RELAXED);
+    do {
+        if (head == INGEST_CLOSED) return -1;
+        ctx->ingest_next = head;
+    } while (!__atomic_compare_exchange_n(&ingest_head, &head, ctx, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    sched_wake();
+    return 0;
+}
+
+/* scheduler loop: apply every queued request, make the batch durable and acknowledge it.
+ * with close=1 the queue is shut first, so nothing can be left behind in it. returns the
+ * number of tasks queued. */
+static int ingest_drain(int close) {
+    struct http_cb_ctx *list = __atomic_exchange_n(&ingest_head, close ? INGEST_CLOSED : NULL, __ATOMIC_ACQUIRE);
+    if (list == NULL || list == INGEST_CLOSED) return 0;
+    struct http_cb_ctx *fifo = NULL;
+    while (list) { struct http_cb_ctx *next = list->ingest_next; list->ingest_next = fifo; fifo = list; list = next; }
+    CarbonSnapshot carbon[MAX_REGIONS];
+    carbon_snapshot_read_all(carbon);
+    int queued = 0, requests = 0;
+    uint64_t lsn = 0;
+    tasks_lock_acquire();
+    for (struct http_cb_ctx *c = fifo; c; c = c->ingest_next) { queued += ingest_apply(c, carbon, &lsn); requests++; }
+    tasks_lock_release();
+    counter_add(COUNTER_SUBMITTED, (uint64_t)queued);
+    counter_add(COUNTER_INGEST_DRAINS, 1);
+    counter_add(COUNTER_INGEST_REQUESTS, (uint64_t)requests);
+    journal_commit(lsn, 1);   /* one fdatasync for every request in the batch */
+    while (fifo) {
+        struct http_cb_ctx *next = fifo->ingest_next;   /* fifo belongs to its request again once acked */
+        struct MHD_Connection *connection = fifo->connection;
+        __atomic_store_n(&fifo->state, INGEST_ACKED, __ATOMIC_RELEASE);
+        if (connection) MHD_resume_connection(connection);
+        fifo = next;
+    }
+    if (queued > 0) carbon_kick();
+    return queued;
+}
+
+/* Prometheus text exposition of the counters, histograms and current queue depths */
+static char *metrics_render(size_t *len) {
+    char *buf = NULL;
+    FILE *f = open_memstream(&buf, len);
+    if (!f) return NULL;
+    for (int c = 0; c < COUNTER_COUNT; ++c)
+        fprintf(f, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counter_names[c][0], counter_names[c][1],
+                counter_names[c][0], counter_names[c][0], (unsigned long long)__atomic_load_n(&counters[c], __ATOMIC_RELAXED));
+    fprintf(f, "# HELP scheduler_log_dropped_total log records dropped on a full ring\n# TYPE scheduler_log_dropped_total counter\n"
+               "scheduler_log_dropped_total %lu\n", __atomic_load_n(&log_dropped, __ATOMIC_RELAXED));
+    for (int h = 0; h < HIST_COUNT; ++h) {
+        const Histogram *x = &histograms[h];
+        const char *name = histogram_names[h][0];
+        fprintf(f, "# HELP %s %s\n# TYPE %s histogram\n", name, histogram_names[h][1], name);
+        uint64_t cumulative = 0;
+        for (int b = 0; b < METRIC_BUCKETS - 1; ++b) {
+            cumulative += __atomic_load_n(&x->buckets[b], __ATOMIC_RELAXED);
+            fprintf(f, "%s_bucket{le=\"%g\"} %llu\n", name, (double)(1ULL << b) / 1e6, (unsigned long long)cumulative);
+        }
+        cumulative += __atomic_load_n(&x->buckets[METRIC_BUCKETS - 1], __ATOMIC_RELAXED);
+        fprintf(f, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %g\n%s_count %llu\n", name, (unsigned long long)cumulative,
+                name, __atomic_load_n(&x->sum_us, __ATOMIC_RELAXED) / 1e6, name, (unsigned long long)cumulative);
+    }
+    static const char *const states[DEPTH_COUNT] = { "pending", "running", "suspended" };
+    fprintf(f, "# HELP scheduler_tasks tasks in the queue by urgency and state\n# TYPE scheduler_tasks gauge\n");
+    for (int r = 0; r < URGENCY_COUNT; ++r)
+        for (int k = 0; k < DEPTH_COUNT; ++k)
+            fprintf(f, "scheduler_tasks{urgency=\"%s\",state=\"%s\"} %d\n", urgency_name(r), states[k],
+                    __atomic_load_n(&depth_gauges[r][k], __ATOMIC_RELAXED));
+    CarbonSnapshot carbon[MAX_REGIONS];
+    carbon_snapshot_read_all(carbon);
+    fprintf(f, "# HELP scheduler_carbon_level carbon intensity level by region (0 unknown, 1 low .. 4 very high)\n"
+               "# TYPE scheduler_carbon_level gauge\n");
+    for (int i = 0; i < carbon_region_count; ++i)
+        fprintf(f, "scheduler_carbon_level{region=\"%s\"} %d\n", carbon_regions[i].name, (int)carbon[i].level);
+    fprintf(f, "# HELP scheduler_carbon_deferring 1 while non-urgent tasks are held back in the region\n"
+               "# TYPE scheduler_carbon_deferring gauge\n");
+    for (int i = 0; i < carbon_region_count; ++i)
+        fprintf(f, "scheduler_carbon_deferring{region=\"%s\"} %d\n", carbon_regions[i].name, carbon[i].deferring);
+    fclose(f);
+    return buf;
+}
+
+static enum MHD_Result http_reply(struct MHD_Connection *connection, unsigned int status, const char *msg) {
+    struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
+    enum MHD_Result ret = MHD_queue_response(connection, status, resp);
+    MHD_destroy_response(resp);
+    return ret;
+}
+
+static int parse_positive(const char *arg, unsigned *out) {
+    char *end;
+    long v = strtol(arg, &end, 10);
+    if (*arg == 0 || *end != 0 || v <= 0) return -1;
+    *out = (unsigned)v;
+    return 0;
+}
+
+/* takes ownership of body, which is sent with the given content type */
+static enum MHD_Result http_reply_owned(struct MHD_Connection *connection, unsigned int status, char *body, size_t len,
+                                        const char *content_type) {
+    struct MHD_Response *resp = MHD_create_response_from_buffer(len, body, MHD_RESPMEM_MUST_FREE);
+    MHD_add_response_header(resp, MHD_HTTP_HEADER_CONTENT_TYPE, content_type);
+    enum MHD_Result ret = MHD_queue_response(connection, status, resp);
+    MHD_destroy_response(resp);
+    return ret;
+}
 
-/* urgency ordering helper */
-static int urgency_rank(const char *u) {
-    if (!u) return 2;
-    if (strcmp(u, "high") == 0) return 0;
-    if (strcmp(u, "medium") == 0) return 1;
-    return 2;
+/* bit mask of the index of value in names, all bits when value is absent, 0 if unknown */
+static unsigned query_mask(const char *value, const char *const *names, int n) {
+    if (!value) return (1u << n) - 1;
+    for (int i = 0; i < n; ++i) if (strcmp(value, names[i]) == 0) return 1u << i;
+    return 0;
 }
 
-/* HTTP POST handling (simple microhttpd usage) */
-struct http_cb_ctx { char *data; size_t size; };
+/* GET /tasks?state=&urgency=&cursor=&limit= and GET /tasks/{id}, served from the read view */
+static enum MHD_Result http_tasks(struct MHD_Connection *connection, const char *url) {
+    static const char *const urgencies[URGENCY_COUNT] = { "high", "medium", "low" };
+    const char *id_text = url[6] == '/' ? url + 7 : NULL;
+    char *end;
+    uint64_t id = 0;
+    if (id_text) {
+        id = strtoull(id_text, &end, 10);
+        if (*id_text == 0 || *end != 0) return http_reply(connection, MHD_HTTP_BAD_REQUEST, "Invalid task id");
+    }
+    unsigned state_mask = query_mask(MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "state"), view_state_names, VIEW_STATES);
+    unsigned urgency_mask = query_mask(MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "urgency"), urgencies, URGENCY_COUNT);
+    const char *cursor_text = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "cursor");
+    const char *limit_text = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "limit");
+    unsigned long cursor = cursor_text ? strtoul(cursor_text, &end, 10) : 0;
+    if (cursor_text && (*cursor_text == 0 || *end != 0 || cursor > UINT32_MAX)) return http_reply(connection, MHD_HTTP_BAD_REQUEST, "Invalid cursor");
+    unsigned limit = TASK_VIEW_PAGE_DEFAULT;
+    if (limit_text && (parse_positive(limit_text, &limit) != 0 || limit > TASK_VIEW_PAGE_MAX)) return http_reply(connection, MHD_HTTP_BAD_REQUEST, "Invalid limit");
+    if (!state_mask || !urgency_mask) return http_reply(connection, MHD_HTTP_BAD_REQUEST, "Unknown state or urgency");
+
+    uint64_t epoch;
+    const TaskView *v = task_view_acquire(&epoch);
+    if (!v) { task_view_exit(epoch); return http_reply(connection, MHD_HTTP_SERVICE_UNAVAILABLE, "Task snapshot not ready"); }
+    struct json_object *root = NULL;
+    if (id_text) {
+        const TaskViewEntry *e = task_view_find(v, id);
+        if (e) root = task_view_json(e);
+    } else root = task_view_page(v, state_mask, urgency_mask, (uint32_t)cursor, (int)limit);
+    char *body = root ? strdup(json_object_to_json_string_ext(root, JSON_C_TO_STRING_PLAIN)) : NULL;
+    task_view_exit(epoch);
+    json_object_put(root);
+    if (!root) return http_reply(connection, MHD_HTTP_NOT_FOUND, "Task not found");
+    return http_reply_owned(connection, MHD_HTTP_OK, body, strlen(body), "application/json");
+}
 
 static enum MHD_Result http_request_handler(void *cls, struct MHD_Connection *connection,
                                 const char *url, const char *method, const char *version,
                                 const char *upload_data, size_t *upload_data_size, void **con_cls) {
     if (*con_cls == NULL) {
-        struct http_cb_ctx *ctx = malloc(sizeof(struct http_cb_ctx));
-        ctx->data = NULL; ctx->size = 0;
+        struct http_cb_ctx *ctx = http_cb_ctx_new();
+        ctx->started_us = mono_us();
         *con_cls = ctx;
         return MHD_YES;
     }
     struct http_cb_ctx *ctx = (struct http_cb_ctx *)*con_cls;
     if (strcmp(method, "POST") == 0 && strcmp(url, "/add_tasks") == 0) {
         if (*upload_data_size != 0) {
-            ctx->data = realloc(ctx->data, ctx->size + *upload_data_size + 1);
-            memcpy(ctx->data + ctx->size, upload_data, *upload_data_size);
-            ctx->size += *upload_data_size;
-            ctx->data[ctx->size] = 0;
+            ingest_feed(ctx, upload_data, *upload_data_size);
             *upload_data_size = 0;
             return MHD_YES;
-        } else {
-            struct json_object *root = json_tokener_parse(ctx->data);
-            if (!root || !json_object_is_type(root, json_type_array)) {
-                const char *msg = "Expected JSON array";
-                struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
-                int ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp);
-                MHD_destroy_response(resp);
-                if (root) json_object_put(root);
-                free(ctx->data); free(ctx); *con_cls = NULL; return ret;
-            }
-            int n = json_object_array_length(root);
-            typedef struct TempTask { char *command; char *urgency; int deadline_hours; time_t submitted_at; int order; } TempTask;
-            TempTask *arr = calloc(n, sizeof(TempTask));
-            for (int i = 0; i < n; ++i) {
-                struct json_object *obj = json_object_array_get_idx(root, i);
-                struct json_object *jcmd = NULL, *jurg = NULL, *jdl = NULL, *jsub = NULL;
-                json_object_object_get_ex(obj, "command", &jcmd);
-                json_object_object_get_ex(obj, "urgency", &jurg);
-                json_object_object_get_ex(obj, "deadline_hours", &jdl);
-                json_object_object_get_ex(obj, "submitted_at", &jsub);
-                const char *cmd = jcmd ? json_object_get_string(jcmd) : NULL;
-                const char *urg = jurg ? json_object_get_string(jurg) : "low";
-                int dl = jdl ? json_object_get_int(jdl) : 0;
-                time_t sub = jsub ? (time_t)json_object_get_int64(jsub) : time(NULL);
-                arr[i].command = cmd ? strdup(cmd) : strdup("");
-                arr[i].urgency = urg ? strdup(urg) : strdup("low");
-                arr[i].deadline_hours = dl;
-                arr[i].submitted_at = sub;
-                arr[i].order = i;
-            }
-            /* stable insertion sort by urgency then original order */
-            for (int i = 1; i < n; ++i) {
-                TempTask key = arr[i];
-                int j = i - 1;
-                while (j >= 0) {
-                    int rj = urgency_rank(arr[j].urgency);
-                    int ri = urgency_rank(key.urgency);
-                    if (rj > ri || (rj == ri && arr[j].order > key.order)) { arr[j+1] = arr[j]; j--; } else break;
-                }
-                arr[j+1] = key;
-            }
-            char *index_now = fetch_carbon_index_with_curl();
-            pthread_mutex_lock(&tasks_lock);
-            for (int i = 0; i < n; ++i) {
-                Task t = {0};
-                t.command = arr[i].command;
-                t.urgency = arr[i].urgency;
-                t.deadline_hours = arr[i].deadline_hours;
-                t.submitted_at = arr[i].submitted_at;
-                t.deadline = t.submitted_at + t.deadline_hours * 3600;
-                t.started = 0; t.delayed = 0; t.pid = 0;
-                if (!tasks_contains(t.command, t.submitted_at)) {
-                    int idx = tasks_append(t);
-                    int urgent = (strcmp(t.urgency, "high") == 0);
-                    int high_carbon = (index_now && (strcmp(index_now, "high") == 0 || strcmp(index_now, "very high") == 0));
-                    if (urgent) run_task(&tasks[idx]);
-                    else {
-                        if (high_carbon && time(NULL) < tasks[idx].deadline) {
-                            tasks[idx].delayed = 1;
-                            timestamp_log(logfp_global);
-                            fprintf(logfp_global, "[INFO] Received and delayed (high carbon): %s | urgency=%s\n", tasks[idx].command, tasks[idx].urgency);
-                            fflush(logfp_global);
-                        } else run_task(&tasks[idx]);
-                    }
-                } else { free(arr[i].command); free(arr[i].urgency); }
-            }
-            pthread_mutex_unlock(&tasks_lock);
-            if (index_now) free(index_now);
-            free(arr);
-            json_object_put(root);
-            free(ctx->data); free(ctx);
-            *con_cls = NULL;
-            const char *msg = "Tasks accepted";
-            struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
-            int ret = MHD_queue_response(connection, MHD_HTTP_OK, resp);
-            MHD_destroy_response(resp);
-            return ret;
-        }
-    }
-    const char *msg = "Not Found";
-    struct MHD_Response *resp = MHD_create_response_from_buffer(strlen(msg), (void*)msg, MHD_RESPMEM_PERSISTENT);
-    int ret = MHD_queue_response(connection, MHD_HTTP_NOT_FOUND, resp);
-    MHD_destroy_response(resp);
-    if (ctx) { if (ctx->data) free(ctx->data); free(ctx); *con_cls = NULL; }
-    return ret;
+        }
+        int state = __atomic_load_n(&ctx->state, __ATOMIC_ACQUIRE);
+        if (state == INGEST_DONE) {
+            /* suspend before queueing, so the loop can only ever resume a suspended connection;
+             * the handler runs again once it is resumed */
+            ctx->connection = connection;
+            MHD_suspend_connection(connection);
+            if (ingest_submit(ctx) != 0) { ctx->state = INGEST_REFUSED; MHD_resume_connection(connection); }
+            return MHD_YES;
+        }
+        if (state == INGEST_QUEUED) return MHD_YES;   /* still the loop's */
+        if (state == INGEST_ACKED) histogram_observe(HIST_SUBMIT_ACK, mono_us() - ctx->started_us);
+        const char *error = ctx->error ? ctx->error : "Expected JSON array";
+        http_cb_ctx_free(ctx); *con_cls = NULL;
+        if (state == INGEST_ACKED) return http_reply(connection, MHD_HTTP_OK, "Tasks accepted");
+        if (state == INGEST_REFUSED) return http_reply(connection, MHD_HTTP_SERVICE_UNAVAILABLE, "Scheduler shutting down");
+        return http_reply(connection, MHD_HTTP_BAD_REQUEST, error);
+    }
+    if (strcmp(method, "GET") == 0 && strcmp(url, "/metrics") == 0) {
+        http_cb_ctx_free(ctx); *con_cls = NULL;
+        size_t len;
+        char *body = metrics_render(&len);
+        if (!body) return http_reply(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "Out of memory");
+        return http_reply_owned(connection, MHD_HTTP_OK, body, len, "text/plain; version=0.0.4");
+    }
+    if (strcmp(method, "GET") == 0 && strncmp(url, "/tasks", 6) == 0 && (url[6] == 0 || url[6] == '/')) {
+        http_cb_ctx_free(ctx); *con_cls = NULL;
+        return http_tasks(connection, url);
+    }
+    http_cb_ctx_free(ctx); *con_cls = NULL;
+    return http_reply(connection, MHD_HTTP_NOT_FOUND, "Not Found");
+}
+
+/* frees the upload context of a request that ended early (client hung up mid-body) */
+static void http_request_completed(void *cls, struct MHD_Connection *connection,
+                                   void **con_cls, enum MHD_RequestTerminationCode toe) {
+    struct http_cb_ctx *ctx = (struct http_cb_ctx *)*con_cls;
+    if (ctx) { http_cb_ctx_free(ctx); *con_cls = NULL; }
+}
+
+static SCHEDULER_ENTRY struct MHD_Daemon *start_http_daemon(void) {
+    if (http_mode == HTTP_MODE_EPOLL)
+        return MHD_start_daemon(MHD_USE_EPOLL_INTERNAL_THREAD | MHD_ALLOW_SUSPEND_RESUME | MHD_USE_ERROR_LOG,
+                                HTTP_PORT, NULL, NULL, &http_request_handler, NULL,
+                                MHD_OPTION_THREAD_POOL_SIZE, http_workers,
+                                MHD_OPTION_CONNECTION_LIMIT, http_max_conns,
+                                MHD_OPTION_CONNECTION_TIMEOUT, http_idle_timeout,
+                                MHD_OPTION_NOTIFY_COMPLETED, &http_request_completed, NULL,
+                                MHD_OPTION_END);
+    return MHD_start_daemon(MHD_USE_SELECT_INTERNALLY | MHD_USE_THREAD_PER_CONNECTION | MHD_ALLOW_SUSPEND_RESUME,
+                            HTTP_PORT, NULL, NULL, &http_request_handler, NULL,
+                            MHD_OPTION_CONNECTION_LIMIT, http_max_conns,
+                            MHD_OPTION_CONNECTION_TIMEOUT, http_idle_timeout,
+                            MHD_OPTION_NOTIFY_COMPLETED, &http_request_completed, NULL,
+                            MHD_OPTION_END);
+}
+
+/* --region NAME=URL[,TTL]: the first one replaces the built-in "default" region. names are
+ * up to 23 letters, digits, '-' and '_'; "any" is taken by tasks that accept every region. */
+static int carbon_region_add(const char *spec) {
+    const char *eq = strchr(spec, '=');
+    if (!eq || eq == spec || (size_t)(eq - spec) >= sizeof(carbon_regions[0].name)) return -1;
+    if (!carbon_regions_configured) { carbon_region_count = 0; carbon_regions_configured = 1; }
+    if (carbon_region_count == MAX_REGIONS) return -1;
+    CarbonRegion *r = &carbon_regions[carbon_region_count];
+    memset(r, 0, sizeof(*r));
+    memcpy(r->name, spec, (size_t)(eq - spec));
+    for (const char *c = r->name; *c; ++c)
+        if (!isalnum((unsigned char)*c) && *c != '-' && *c != '_') return -1;
+    if (region_lookup(r->name) != -1) return -1;   /* "any" or a duplicate */
+    const char *url = eq + 1, *comma = strrchr(url, ',');
+    size_t url_len = strlen(url);
+    r->ttl = POLL_INTERVAL;
+    if (comma && parse_positive(comma + 1, &r->ttl) == 0) url_len = (size_t)(comma - url);
+    while (url_len > 0 && url[url_len - 1] == '/') url_len--;
+    if (url_len == 0 || url_len >= sizeof(r->base)) return -1;
+    memcpy(r->base, url, url_len);
+    carbon_region_count++;
+    return 0;
+}
+
+static SCHEDULER_ENTRY void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-f] [--http-mode thread|epoll] [--http-workers N] [--http-max-conns N] [--http-idle-timeout SEC]\n"
+            "          [--max-running-high N] [--max-running-medium N] [--max-running-low N] [--preempt high|very-high]\n"
+            "          [--journal PREFIX] [--region NAME=URL[,TTL]]...\n"
+            "  -f                   run in the foreground\n"
+            "  --http-mode          thread: one thread per connection (default); epoll: worker pool\n"
+            "  --http-workers       epoll worker threads (default %d)\n"
+            "  --http-max-conns     concurrent connection limit (default %d)\n"
+            "  --http-idle-timeout  seconds before an idle keep-alive connection is closed (default %d)\n"
+            "  --max-running-*      concurrent children per urgency class (default %d/%d/%d)\n"
+            "  --preempt            stop running non-urgent tasks at this carbon level (default off)\n"
+            "  --journal            path prefix of the task journal and snapshot (default %s)\n"
+            "  --region             carbon API base URL of a named region, its reading trusted for TTL seconds\n"
+            "                       (default %d); repeat for up to %d regions (default: one region \"default\" at %s)\n",
+            prog, HTTP_DEFAULT_WORKERS, HTTP_DEFAULT_MAX_CONNS, HTTP_DEFAULT_IDLE_TIMEOUT,
+            DEFAULT_MAX_RUNNING_HIGH, DEFAULT_MAX_RUNNING_MEDIUM, DEFAULT_MAX_RUNNING_LOW, JOURNAL_PREFIX,
+            POLL_INTERVAL, MAX_REGIONS, CARBON_API_BASE);
+}
+
+static SCHEDULER_ENTRY int parse_args(int argc, char *argv[]) {
+    static const struct option opts[] = {
+        { "foreground", no_argument, NULL, 'f' },
+        { "http-mode", required_argument, NULL, 'm' },
+        { "http-workers", required_argument, NULL, 'w' },
+        { "http-max-conns", required_argument, NULL, 'c' },
+        { "http-idle-timeout", required_argument, NULL, 't' },
+        { "max-running-high", required_argument, NULL, 'H' },
+        { "max-running-medium", required_argument, NULL, 'M' },
+        { "max-running-low", required_argument, NULL, 'L' },
+        { "preempt", required_argument, NULL, 'p' },
+        { "journal", required_argument, NULL, 'j' },
+        { "region", required_argument, NULL, 'r' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f", opts, NULL)) != -1) {
+        switch (opt) {
+        case 'f': running_foreground = 1; break;
+        case 'm':
+            if (strcmp(optarg, "thread") == 0) http_mode = HTTP_MODE_THREAD;
+            else if (strcmp(optarg, "epoll") == 0) http_mode = HTTP_MODE_EPOLL;
+            else return -1;
+            break;
+        case 'w': if (parse_positive(optarg, &http_workers) != 0) return -1; break;
+        case 'c': if (parse_positive(optarg, &http_max_conns) != 0) return -1; break;
+        case 't': if (parse_positive(optarg, &http_idle_timeout) != 0) return -1; break;
+        case 'H': if (parse_positive(optarg, &max_running[URGENCY_HIGH]) != 0) return -1; break;
+        case 'M': if (parse_positive(optarg, &max_running[URGENCY_MEDIUM]) != 0) return -1; break;
+        case 'L': if (parse_positive(optarg, &max_running[URGENCY_LOW]) != 0) return -1; break;
+        case 'p':
+            if (strcmp(optarg, "high") == 0) preempt_level = CARBON_HIGH;
+            else if (strcmp(optarg, "very-high") == 0) preempt_level = CARBON_VERY_HIGH;
+            else return -1;
+            break;
+        case 'j': if (*optarg == 0) return -1; journal_prefix = optarg; break;
+        case 'r': if (carbon_region_add(optarg) != 0) return -1; break;
+        default: return -1;
+        }
+    }
+    return optind == argc ? 0 : -1;
 }
 
 /* main signal handler for SIGINT/SIGTERM to request exit */
-static void signal_handler(int sig) {
+static SCHEDULER_ENTRY void signal_handler(int sig) {
+    int saved = errno;
     exit_requested = 1;
-    if (logfp_global) { timestamp_log(logfp_global); fprintf(logfp_global, "[INFO] Signal %d received\n", sig); fflush(logfp_global); }
+    exit_signal = sig;
+    sched_wake();
+    errno = saved;
 }
 
+/* bench_scheduler.c includes this file with SCHEDULER_NO_MAIN to reuse the internals */
+#ifndef SCHEDULER_NO_MAIN
 int main(int argc, char *argv[]) {
-    if (argc > 1 && strcmp(argv[1], "-f") == 0) running_foreground = 1;
+    if (parse_args(argc, argv) != 0) { usage(argv[0]); return 2; }
+    carbon_regions_init();
     logfp_global = fopen(LOG_FILE, "a+");
     if (!logfp_global) return 1;
 
@@ -331,90 +3450,144 @@ int main(int argc, char *argv[]) {
         FILE *pidf = fopen(PID_FILE, "w"); if (pidf) { fprintf(pidf, "%d\n", getpid()); fclose(pidf); }
     }
 
+    /* logger thread starts after daemonizing, since threads do not survive fork() */
+    log_init();
+    if (log_wake_fd < 0 || log_start() != 0) return 1;
+
+    if (sched_init() != 0) return 1;
+    if (journal_start() != 0) return 1;
+
     /* install handlers */
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
-    /* no SIGCHLD handler; using blocking watcher thread instead */
-    /* install noop handler for SIGUSR1 to allow pthread_kill interruptions if needed */
-    signal(SIGUSR1, noop_signal_handler);
+    /* no SIGCHLD handler: children are tracked through pidfds by the watcher thread */
+    if (reap_init() != 0) return 1;
 
     curl_global_init(CURL_GLOBAL_DEFAULT);
-    struct MHD_Daemon *daemon = MHD_start_daemon(MHD_USE_SELECT_INTERNALLY | MHD_USE_THREAD_PER_CONNECTION,
-                                                 HTTP_PORT, NULL, NULL, &http_request_handler, NULL, MHD_OPTION_END);
+    CURLM *carbon_multi = curl_multi_init();
+    if (!carbon_multi) return 1;
+    carbon_fetch_round(carbon_multi);   /* every region's reading and forecast, concurrently */
+    pthread_t carbon_thread;
+    if (pthread_create(&carbon_thread, NULL, carbon_refresher, carbon_multi) != 0) return 1;
+
+    struct MHD_Daemon *daemon = start_http_daemon();
     if (!daemon) return 1;
 
-    timestamp_log(logfp_global);
-    fprintf(logfp_global, "[INFO] REST scheduler started on port %d\n", HTTP_PORT);
-    fflush(logfp_global);
+    if (http_mode == HTTP_MODE_EPOLL)
+        log_msg("[INFO] REST scheduler started on port %d (epoll, %u workers, max %u connections)\n",
+                HTTP_PORT, http_workers, http_max_conns);
+    else
+        log_msg("[INFO] REST scheduler started on port %d (thread per connection, max %u connections)\n",
+                HTTP_PORT, http_max_conns);
 
-    /* start watcher thread that blocks on waitpid */
+    /* start watcher thread that blocks in epoll_wait on child pidfds */
     pthread_t watcher_thread;
     if (pthread_create(&watcher_thread, NULL, task_completion_watcher, NULL) != 0) {
-        timestamp_log(logfp_global);
-        fprintf(logfp_global, "[ERROR] Failed to start watcher thread\n");
-        fflush(logfp_global);
+        log_msg("[ERROR] Failed to start watcher thread\n");
     }
 
-    /* precise next-poll time */
-    struct timespec next_poll;
-    clock_gettime(CLOCK_MONOTONIC, &next_poll);
-    next_poll.tv_sec += POLL_INTERVAL;
-
+    /* scheduler loop: sleeps in epoll_wait until woken (requests in the ingest queue, a task
+     * finished, carbon state changed, signal) or the timer fires for the next planned start or deadline.
+     * with nothing queued the timer is disarmed, so an idle daemon does not wake at all. */
+    LaunchBatch batch = {0};
+    time_t status_logged_at = 0;
+    sched_wake();   /* first pass */
     while (!exit_requested) {
-        char *index = fetch_carbon_index_with_curl();
-        pthread_mutex_lock(&tasks_lock);
-        time_t now = time(NULL);
-        for (int i = 0; i < task_count; ++i) {
-            if (tasks[i].started) continue;
-            int urgent = (tasks[i].urgency && strcmp(tasks[i].urgency, "high") == 0);
-            int high_carbon = (index && (strcmp(index, "high") == 0 || strcmp(index, "very high") == 0));
-            if (urgent) run_task(&tasks[i]);
-            else {
-                if (high_carbon && now < tasks[i].deadline) {
-                    tasks[i].delayed = 1;
-                    timestamp_log(logfp_global);
-                    fprintf(logfp_global, "[INFO] Deferred due to high carbon: %s\n", tasks[i].command);
-                    fflush(logfp_global);
-                } else run_task(&tasks[i]);
-            }
+        struct epoll_event events[2];
+        int n = epoll_wait(sched_epoll_fd, events, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log_msg("[ERROR] Scheduler epoll_wait failed: %s\n", strerror(errno));
+            break;
         }
-        pthread_mutex_unlock(&tasks_lock);
-        if (index) free(index);
+        uint64_t count;
+        for (int k = 0; k < n; ++k) { ssize_t r = read(events[k].data.fd, &count, sizeof(count)); (void)r; }
+        if (exit_requested) break;
+        ingest_drain(0);
 
-        struct timespec now_ts;
-        clock_gettime(CLOCK_MONOTONIC, &now_ts);
-        long sleep_ms = (next_poll.tv_sec - now_ts.tv_sec) * 1000 +
-                        (next_poll.tv_nsec - now_ts.tv_nsec) / 1000000;
-        if (sleep_ms < 0) sleep_ms = 0;
-        struct timespec sleep_dur = { (time_t)(sleep_ms / 1000), (long)((sleep_ms % 1000) * 1000000) };
-        nanosleep(&sleep_dur, NULL);
-        next_poll.tv_sec += POLL_INTERVAL;
+        time_t now = clock_now();
+        time_t next = scheduler_step(&batch, now, &status_logged_at);
+        time_t view_next = task_view_maintain(now);
+        if (view_next > 0 && (next == 0 || view_next < next)) next = view_next;
+        sched_arm(next);
+        journal_maintain();
     }
 
     /* shutdown */
+    if (exit_signal) log_msg("[INFO] Signal %d received\n", (int)exit_signal);
+    ingest_drain(1);   /* answer whatever is queued; later submits get 503 */
     MHD_stop_daemon(daemon);
 
-    /* wake watcher thread if it's blocked */
+    pthread_mutex_lock(&carbon_wait_lock);
     exit_requested = 1;
-    pthread_kill(watcher_thread, SIGUSR1);
+    pthread_cond_broadcast(&carbon_wait_cond);
+    pthread_mutex_unlock(&carbon_wait_lock);
+    curl_multi_wakeup(carbon_multi);   /* out of a round still waiting on a slow API */
+    pthread_join(carbon_thread, NULL);
+    for (int i = 0; i < carbon_region_count; ++i)
+        for (int k = 0; k < 2; ++k) {
+            if (carbon_regions[i].easy[k]) curl_easy_cleanup(carbon_regions[i].easy[k]);
+            free(carbon_regions[i].body[k].memory);
+        }
+    curl_multi_cleanup(carbon_multi);
+
+    /* never leave stopped children behind */
+    if (preempt_level != CARBON_UNKNOWN) {
+        CarbonSnapshot carbon[MAX_REGIONS];
+        carbon_snapshot_read_all(carbon);
+        tasks_lock_acquire();
+        preempt_apply(carbon, clock_now(), 1);
+        tasks_lock_release();
+    }
+
+    /* wake the watcher out of epoll_wait */
+    uint64_t one = 1;
+    if (write(reap_wake_fd, &one, sizeof(one)) < 0) log_msg("[WARN] Cannot wake completion watcher: %s\n", strerror(errno));
     pthread_join(watcher_thread, NULL);
+    close(reap_wake_fd);
+    close(reap_epoll_fd);
+    journal_shutdown();
+    close(sched_timer_fd);
+    close(sched_wake_fd);
+    close(sched_epoll_fd);
 
-    timestamp_log(logfp_global);
-    fprintf(logfp_global, "[SUMMARY] Completed tasks: %d\n", completed_tasks);
+    log_msg("[SUMMARY] Completed tasks: %d\n", completed_tasks);
     if (completed_tasks > 0)
-        fprintf(logfp_global, "[SUMMARY] Average delay (sec): %.2f\n", total_delay_seconds / completed_tasks);
+        log_msg("[SUMMARY] Average delay (sec): %.2f\n", total_delay_seconds / completed_tasks);
     else
-        fprintf(logfp_global, "[SUMMARY] No completed tasks\n");
-    fflush(logfp_global);
+        log_msg("[SUMMARY] No completed tasks\n");
+    for (int r = 0; r < URGENCY_COUNT; ++r) {
+        const UsageTotals *u = &usage_totals[r];
+        if (u->tasks == 0) continue;
+        log_msg("[SUMMARY] %s urgency: %d tasks (%d failed) | CPU: %.1f sec | Suspended: %.0f sec | Peak RSS: %ld KB | Est: %.3f gCO2\n",
+                urgency_name(r), u->tasks, u->failed, u->cpu_sec, u->suspended_sec, u->max_rss_kb, u->gco2);
+    }
+    log_msg("[SUMMARY] Log records dropped: %lu\n", __atomic_load_n(&log_dropped, __ATOMIC_RELAXED));
+    log_shutdown();
 
     curl_global_cleanup();
     fclose(logfp_global);
 
-    pthread_mutex_lock(&tasks_lock);
-    for (int i = 0; i < task_count; ++i) { free(tasks[i].command); free(tasks[i].urgency); }
-    free(tasks);
-    pthread_mutex_unlock(&tasks_lock);
+    tasks_lock_acquire();
+    for (int i = 0; i < task_count; ++i) task_string_free(task_cold[i].command);
+    free(task_hot);
+    free(task_cold);
+    free(task_index);
+    free(pid_map);
+    for (int g = 0; g < PENDING_GROUPS; ++g)
+        for (int r = 0; r < URGENCY_COUNT; ++r) free(pending[g][r].items);
+    free(reap_unwatched);
+    free(task_active);
+    for (int i = 0; i < carbon_region_count; ++i) { free(carbon_regions[i].plan); free(carbon_regions[i].envp); }
+    free(batch.items);
+    task_view_free(task_view_retired);
+    task_view_free(task_view_current);
+    for (int i = 0; i < task_limbo_count; ++i) task_string_free(task_limbo[i]);
+    free(task_limbo);
+    task_strings_release();
+    tasks_lock_release();
     pthread_mutex_destroy(&tasks_lock);
 
     return 0;
 }
+#endif
@@ -0,0 +1,236 @@
+/* C stand-in for mock_carbon_api.py: serves /intensity and /intensity/{from}/fw48h with the
+ * same JSON and the same level cycle, with an optional per-response delay so slow or
+ * jittery carbon APIs can be reproduced locally. no dependencies beyond libc and pthreads.
+ *
+ * Build:
+ *   gcc -O2 -o mock_carbon_api mock_carbon_api.c -lpthread -lm
+ * Run:
+ *   ./mock_carbon_api                          cycle low -> very high every 120 s on port 5000
+ *   ./mock_carbon_api --level high --latency-ms 200 --jitter-ms 50
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define DEFAULT_PORT 5000
+#define DEFAULT_CYCLE_SEC 120
+#define REQUEST_MAX 4096
+#define FORECAST_SLOTS 96
+
+typedef struct Level { const char *index; int forecast; } Level;
+
+static const Level levels[] = {
+    { "low", 80 }, { "moderate", 150 }, { "high", 260 }, { "very high", 380 }
+};
+#define LEVEL_COUNT ((int)(sizeof(levels) / sizeof(levels[0])))
+
+static int fixed_level = -1;        /* -1: cycle */
+static unsigned cycle_sec = DEFAULT_CYCLE_SEC;
+static unsigned latency_ms = 0;
+static unsigned jitter_ms = 0;
+
+/* daily shape: greenest overnight, peak in the early evening, with a slow wobble */
+static int forecast_at(time_t t) {
+    double hour = (double)(t % 86400) / 3600;
+    return (int)(190 + 90 * cos(2 * M_PI * (hour - 18) / 24) + 25 * sin((double)t / 5400));
+}
+
+static const char *index_for(int forecast) {
+    if (forecast < 120) return "low";
+    if (forecast < 200) return "moderate";
+    if (forecast < 280) return "high";
+    return "very high";
+}
+
+static void format_slot(char *buf, size_t len, time_t t) {
+    struct tm tm;
+    strftime(buf, len, "%Y-%m-%dT%H:%MZ", gmtime_r(&t, &tm));
+}
+
+/* body for /intensity; returns its length */
+static int render_current(char *buf, size_t len) {
+    time_t now = time(NULL);
+    const Level *l = &levels[fixed_level >= 0 ? fixed_level : (int)(now / cycle_sec % LEVEL_COUNT)];
+    char from[32], to[32];
+    format_slot(from, sizeof(from), now);
+    format_slot(to, sizeof(to), now + 600);
+    return snprintf(buf, len,
+                    "{\"data\":[{\"from\":\"%s\",\"to\":\"%s\",\"intensity\":{\"forecast\":%d,\"actual\":%d,\"index\":\"%s\"}}]}",
+                    from, to, l->forecast, l->forecast, l->index);
+}
+
+/* body for /intensity/{start}/fw48h, starting with the half-hour slot containing start;
+ * -1 if start does not parse */
+static int render_forecast(char *buf, size_t len, const char *start) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(start, "%Y-%m-%dT%H:%MZ", &tm);
+    if (!end || *end) return -1;
+    time_t t0 = timegm(&tm) / 1800 * 1800;
+    size_t n = (size_t)snprintf(buf, len, "{\"data\":[");
+    for (int i = 0; i < FORECAST_SLOTS && n < len; ++i) {
+        time_t t = t0 + (time_t)i * 1800;
+        int forecast = forecast_at(t);
+        char from[32], to[32];
+        format_slot(from, sizeof(from), t);
+        format_slot(to, sizeof(to), t + 1800);
+        n += (size_t)snprintf(buf + n, len - n,
+                              "%s{\"from\":\"%s\",\"to\":\"%s\",\"intensity\":{\"forecast\":%d,\"actual\":null,\"index\":\"%s\"}}",
+                              i ? "," : "", from, to, forecast, index_for(forecast));
+    }
+    if (n < len) n += (size_t)snprintf(buf + n, len - n, "]}");
+    return n < len ? (int)n : -1;
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t w = send(fd, buf, len, MSG_NOSIGNAL);
+        if (w < 0) { if (errno == EINTR) continue; return -1; }
+        buf += w; len -= (size_t)w;
+    }
+    return 0;
+}
+
+static void respond_delay(unsigned *seed) {
+    unsigned ms = latency_ms + (jitter_ms ? (unsigned)rand_r(seed) % (jitter_ms + 1) : 0);
+    if (ms == 0) return;
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+/* one thread per connection, HTTP/1.1 keep-alive; request bodies are not expected */
+static void *serve_connection(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    unsigned seed = (unsigned)fd ^ (unsigned)time(NULL);
+    char req[REQUEST_MAX];
+    char body[FORECAST_SLOTS * 160];
+    size_t have = 0;
+    for (;;) {
+        char *eoh;
+        while (!(eoh = memmem(req, have, "\r\n\r\n", 4))) {
+            if (have == sizeof(req)) goto out;
+            ssize_t r = recv(fd, req + have, sizeof(req) - have, 0);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) goto out;
+            have += (size_t)r;
+        }
+        int close_after = memmem(req, (size_t)(eoh - req), "Connection: close", 17) != NULL;
+        *eoh = 0;
+        char method[8], path[256];
+        int len = -1, status = 404;
+        if (sscanf(req, "%7s %255s", method, path) == 2 && strcmp(method, "GET") == 0) {
+            char start[64];
+            if (strcmp(path, "/intensity") == 0) { len = render_current(body, sizeof(body)); status = 200; }
+            else if (sscanf(path, "/intensity/%63[^/]/fw48h", start) == 1) {
+                len = render_forecast(body, sizeof(body), start);
+                status = len < 0 ? 400 : 200;
+            }
+        }
+        if (len < 0) len = snprintf(body, sizeof(body), "{\"error\":%d}", status);
+        respond_delay(&seed);
+        char head[256];
+        int hlen = snprintf(head, sizeof(head),
+                            "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\n%s\r\n",
+                            status, status == 200 ? "OK" : status == 400 ? "Bad Request" : "Not Found", len,
+                            close_after ? "Connection: close\r\n" : "");
+        if (write_all(fd, head, (size_t)hlen) != 0 || write_all(fd, body, (size_t)len) != 0 || close_after) break;
+        size_t used = (size_t)(eoh + 4 - req);
+        memmove(req, req + used, have - used);
+        have -= used;
+    }
+out:
+    close(fd);
+    return NULL;
+}
+
+static int parse_level(const char *arg) {
+    for (int i = 0; i < LEVEL_COUNT; ++i)
+        if (strcmp(arg, levels[i].index) == 0) return i;
+    return strcmp(arg, "very-high") == 0 ? LEVEL_COUNT - 1 : -2;
+}
+
+static int parse_uint(const char *arg, unsigned *out) {
+    char *end;
+    errno = 0;
+    unsigned long v = strtoul(arg, &end, 10);
+    if (errno != 0 || end == arg || *end != 0 || *arg == '-' || v > 3600000) return -1;
+    *out = (unsigned)v;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--port N] [--level low|moderate|high|very-high] [--cycle-sec N] [--latency-ms N] [--jitter-ms N]\n"
+            "  --port        listen port on 127.0.0.1 (default %d)\n"
+            "  --level       always report this level (default: cycle through all four)\n"
+            "  --cycle-sec   seconds per level when cycling (default %d)\n"
+            "  --latency-ms  delay before every response (default 0)\n"
+            "  --jitter-ms   extra uniform random delay of up to N ms (default 0)\n",
+            prog, DEFAULT_PORT, DEFAULT_CYCLE_SEC);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option opts[] = {
+        { "port", required_argument, NULL, 'p' },
+        { "level", required_argument, NULL, 'l' },
+        { "cycle-sec", required_argument, NULL, 'c' },
+        { "latency-ms", required_argument, NULL, 'd' },
+        { "jitter-ms", required_argument, NULL, 'j' },
+        { NULL, 0, NULL, 0 }
+    };
+    unsigned port = DEFAULT_PORT;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", opts, NULL)) != -1) {
+        int bad = 0;
+        switch (opt) {
+        case 'p': bad = parse_uint(optarg, &port) != 0 || port == 0 || port > 65535; break;
+        case 'l': bad = (fixed_level = parse_level(optarg)) == -2; break;
+        case 'c': bad = parse_uint(optarg, &cycle_sec) != 0 || cycle_sec == 0; break;
+        case 'd': bad = parse_uint(optarg, &latency_ms) != 0; break;
+        case 'j': bad = parse_uint(optarg, &jitter_ms) != 0; break;
+        default: bad = 1;
+        }
+        if (bad) { usage(argv[0]); return 2; }
+    }
+    if (optind != argc) { usage(argv[0]); return 2; }
+
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 128) != 0) {
+        fprintf(stderr, "cannot listen on 127.0.0.1:%u: %s\n", port, strerror(errno));
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    printf("mock carbon API on 127.0.0.1:%u (%s, latency %u+%u ms)\n", port,
+           fixed_level >= 0 ? levels[fixed_level].index : "cycling", latency_ms, jitter_ms);
+    fflush(stdout);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (;;) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) { if (errno == EINTR || errno == ECONNABORTED) continue; break; }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        pthread_t tid;
+        if (pthread_create(&tid, &attr, serve_connection, (void *)(intptr_t)fd) != 0) close(fd);
+    }
+    perror("accept");
+    return 1;
+}
@@ -229,6 +229,22 @@ void load_tasks(FILE *logfp) {
     fflush(logfp);
 }
 
+// Collect every exited child without blocking and log its completion
+void reap_children(FILE *logfp) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (int i = 0; i < task_count; i++) {
+            if (tasks[i].pid == pid) {
+                time_t end = time(NULL);
+                fprintf(logfp, "Completed: %s | PID: %d | Time: %s",
+                        tasks[i].command, pid, ctime(&end));
+                fflush(logfp);
+            }
+        }
+    }
+}
+
 int main(int argc, char *argv[]) {
     FILE *logfp = fopen(LOG_FILE, "a+");
     if (!logfp) return 1;
@@ -275,21 +291,12 @@ int main(int argc, char *argv[]) {
             }
         }
         
-        int status;
-        pid_t pid;
-        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-            for (int i = 0; i < task_count; i++) {
-                if (tasks[i].pid == pid) {
-                    time_t end = time(NULL);
-                    fprintf(logfp, "Completed: %s | PID: %d | Time: %s",
-                            tasks[i].command, pid, ctime(&end));
-                    fflush(logfp);
-                }
-            }
-        }
-        
         free(intensity);
-        sleep(300); // Check every 5 minutes
+        // Check every 5 minutes, reaping finished tasks every second meanwhile
+        for (int s = 0; s < 300; s++) {
+            reap_children(logfp);
+            sleep(1);
+        }
     }
 
     curl_easy_cleanup(curl);
@@ -0,0 +1,435 @@
+/* Virtual-clock simulation of the scheduler core.
+ *
+ * Replays a carbon intensity trace and a task arrival trace through the daemon's own ingest,
+ * deferral, forecast planning, admission, preemption and usage accounting, on a clock that
+ * jumps from one event to the next. Nothing is executed: a modeled executor (sim_spawn,
+ * sim_kill) keeps each task busy on one core for the runtime given in its trace row, and
+ * SIGSTOP / SIGCONT pause and extend it. The carbon API is read at the daemon's refresh
+ * cadence from the intensity trace, and the forecast is the trace itself (perfect foresight).
+ *
+ * Build (same libraries as the daemon):
+ *   gcc -O2 -o simulate_scheduler simulate_scheduler.c -lcurl -ljson-c -lmicrohttpd -lpthread -lm
+ * Run:
+ *   ./simulate_scheduler --intensity intensity.csv --tasks tasks.csv [--max-running-low N] [--preempt high]
+ *
+ * intensity.csv rows: time,gco2_per_kwh[,index], in time order; each reading holds until the
+ *   next one. without an index the level comes from the forecast (mock_carbon_api.py's bands).
+ * tasks.csv rows: arrival_time,urgency,deadline_hours,runtime_seconds.
+ * times are epoch seconds or "2024-11-05T12:30Z"; lines starting with '#' are skipped.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define SIM_PID_BASE 1000000   /* modeled child of job i gets pid SIM_PID_BASE + i */
+
+typedef struct SimReading { time_t at; int forecast; char index[16]; } SimReading;
+
+typedef struct SimJob {
+    time_t arrival;
+    time_t runtime;
+    int urgency;
+    int deadline_hours;
+    time_t started_at;      /* 0 until launched */
+    time_t finished_at;
+    time_t resumed_at;      /* start of the current run interval */
+    time_t remaining;       /* runtime left at resumed_at */
+    unsigned version;       /* bumped on every stop, so stale completions are skipped */
+    int stopped;
+    double intensity_sec;   /* gCO2/kWh integrated over the time it actually ran */
+} SimJob;
+
+typedef struct SimCompletion { time_t at; int job; unsigned version; } SimCompletion;
+
+static time_t sim_clock = 0;
+static SimReading *sim_readings = NULL;
+static int sim_reading_count = 0;
+static SimJob *sim_jobs = NULL;
+static int sim_job_count = 0;
+static SimCompletion *sim_done = NULL;   /* min-heap on at */
+static int sim_done_count = 0;
+static int sim_done_capacity = 0;
+static int sim_running = 0, sim_suspended = 0;
+static int sim_peak_running = 0, sim_peak_busy = 0;
+
+static time_t sim_now(void) { return sim_clock; }
+
+/* index of the reading in force at t (the first one before the trace starts) */
+static int sim_reading_at(time_t t) {
+    int lo = 0, hi = sim_reading_count;   /* first reading after t */
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (sim_readings[mid].at <= t) lo = mid + 1; else hi = mid;
+    }
+    return lo > 0 ? lo - 1 : 0;
+}
+
+/* intensity integrated over [t0, t1), in gCO2/kWh seconds; the last reading holds forever */
+static double sim_integral(time_t t0, time_t t1) {
+    double sum = 0;
+    for (int i = sim_reading_at(t0); t0 < t1; ++i) {
+        time_t end = i + 1 < sim_reading_count && sim_readings[i + 1].at < t1 ? sim_readings[i + 1].at : t1;
+        sum += (double)sim_readings[i].forecast * (double)(end - t0);
+        t0 = end;
+    }
+    return sum;
+}
+
+static void sim_done_push(time_t at, int job, unsigned version) {
+    if (sim_done_count == sim_done_capacity) {
+        sim_done_capacity = sim_done_capacity ? sim_done_capacity * 2 : 1024;
+        sim_done = realloc(sim_done, sizeof(SimCompletion) * sim_done_capacity);
+    }
+    SimCompletion e = { at, job, version };
+    int i = sim_done_count++;
+    while (i > 0 && sim_done[(i - 1) / 2].at > e.at) { sim_done[i] = sim_done[(i - 1) / 2]; i = (i - 1) / 2; }
+    sim_done[i] = e;
+}
+
+static SimCompletion sim_done_pop(void) {
+    SimCompletion top = sim_done[0], last = sim_done[--sim_done_count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= sim_done_count) break;
+        if (child + 1 < sim_done_count && sim_done[child + 1].at < sim_done[child].at) child++;
+        if (sim_done[child].at >= last.at) break;
+        sim_done[i] = sim_done[child];
+        i = child;
+    }
+    if (sim_done_count > 0) sim_done[i] = last;
+    return top;
+}
+
+static void sim_track_peaks(void) {
+    if (sim_running > sim_peak_running) sim_peak_running = sim_running;
+    if (sim_running + sim_suspended > sim_peak_busy) sim_peak_busy = sim_running + sim_suspended;
+}
+
+/* modeled executor: commands are "sim <job>", and the child runs for the job's runtime */
+static int sim_spawn(char *const argv[], char *const envp[], int urgency, pid_t *out_pid) {
+    (void)envp;
+    (void)urgency;
+    int i = atoi(argv[1]);
+    SimJob *j = &sim_jobs[i];
+    j->started_at = j->resumed_at = sim_clock;
+    j->remaining = j->runtime;
+    sim_running++;
+    sim_track_peaks();
+    sim_done_push(sim_clock + j->runtime, i, j->version);
+    *out_pid = SIM_PID_BASE + i;
+    return 0;
+}
+
+static void sim_watch(pid_t pid) { (void)pid; }   /* completions come from the sim_done heap */
+
+static int sim_kill(pid_t pid, int sig) {
+    SimJob *j = &sim_jobs[(pid < 0 ? -pid : pid) - SIM_PID_BASE];
+    if (sig == SIGSTOP && !j->stopped) {
+        j->intensity_sec += sim_integral(j->resumed_at, sim_clock);
+        j->remaining -= sim_clock - j->resumed_at;
+        j->stopped = 1;
+        j->version++;
+        sim_running--; sim_suspended++;
+    } else if (sig == SIGCONT && j->stopped) {
+        j->resumed_at = sim_clock;
+        j->stopped = 0;
+        sim_running++; sim_suspended--;
+        sim_track_peaks();
+        sim_done_push(sim_clock + j->remaining, (int)(j - sim_jobs), j->version);
+    }
+    return 0;
+}
+
+#define SCHEDULER_NO_MAIN
+#define SCHEDULER_SIMULATED
+#include "main_code.c"
+#include <math.h>
+
+static int sim_forecast_enabled = 1;
+
+/* epoch seconds or "2024-11-05T12:30Z"; -1 if neither */
+static time_t sim_parse_time(const char *s) {
+    struct tm tm = {0};
+    const char *end = strptime(s, "%Y-%m-%dT%H:%M", &tm);
+    if (end && (*end == 'Z' || *end == 0)) return timegm(&tm);
+    char *e;
+    long long v = strtoll(s, &e, 10);
+    return e != s && *e == 0 ? (time_t)v : -1;
+}
+
+/* split a CSV line in place into at most max fields; returns the count */
+static int sim_split(char *line, char **fields, int max) {
+    int n = 0;
+    line[strcspn(line, "\r\n")] = 0;
+    for (char *save = NULL, *f = strtok_r(line, ",", &save); f && n < max; f = strtok_r(NULL, ",", &save)) {
+        while (*f == ' ') f++;
+        fields[n++] = f;
+    }
+    return n;
+}
+
+static int sim_load_intensity(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) { fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno)); return -1; }
+    char line[256], *fields[3];
+    int capacity = 0, lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        int n = sim_split(line, fields, 3);
+        time_t at = n >= 2 ? sim_parse_time(fields[0]) : -1;
+        if (at < 0 || (sim_reading_count > 0 && at <= sim_readings[sim_reading_count - 1].at)) {
+            if (lineno == 1) continue;   /* header */
+            fprintf(stderr, "%s:%d: bad or out-of-order reading\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        if (sim_reading_count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            sim_readings = realloc(sim_readings, sizeof(SimReading) * capacity);
+        }
+        SimReading *r = &sim_readings[sim_reading_count++];
+        r->at = at;
+        r->forecast = atoi(fields[1]);
+        snprintf(r->index, sizeof(r->index), "%s", n >= 3 ? fields[2] : "");
+    }
+    fclose(f);
+    if (sim_reading_count == 0) { fprintf(stderr, "%s: no readings\n", path); return -1; }
+    return 0;
+}
+
+static int sim_load_tasks(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) { fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno)); return -1; }
+    char line[256], *fields[4];
+    int capacity = 0, lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        int n = sim_split(line, fields, 4);
+        time_t at = n == 4 ? sim_parse_time(fields[0]) : -1;
+        double runtime = n == 4 ? atof(fields[3]) : -1;
+        if (at < 0 || runtime < 0 || (sim_job_count > 0 && at < sim_jobs[sim_job_count - 1].arrival)) {
+            if (lineno == 1) continue;   /* header */
+            fprintf(stderr, "%s:%d: bad or out-of-order task\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        if (sim_job_count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            sim_jobs = realloc(sim_jobs, sizeof(SimJob) * capacity);
+        }
+        SimJob *j = &sim_jobs[sim_job_count++];
+        memset(j, 0, sizeof(*j));
+        j->arrival = at;
+        j->urgency = parse_urgency(fields[1]);
+        j->deadline_hours = atoi(fields[2]);
+        j->runtime = (time_t)ceil(runtime);
+    }
+    fclose(f);
+    return 0;
+}
+
+/* one carbon API read at the current virtual time: the reading in force, valid until the next */
+static void sim_carbon_refresh(void) {
+    int i = sim_reading_at(sim_clock);
+    const SimReading *r = &sim_readings[i];
+    CarbonSnapshot snap;
+    memset(&snap, 0, sizeof(snap));
+    snap.forecast = r->forecast;
+    if (r->index[0]) snap.level = parse_carbon_level(r->index);
+    else snap.level = r->forecast < 120 ? CARBON_LOW : r->forecast < 200 ? CARBON_MODERATE
+                    : r->forecast < 280 ? CARBON_HIGH : CARBON_VERY_HIGH;
+    snap.valid_from = r->at;
+    snap.valid_to = i + 1 < sim_reading_count ? sim_readings[i + 1].at : r->at + 1800;
+    snap.fetched_at = sim_clock;
+    carbon_apply(0, &snap);
+}
+
+/* the forecast the daemon would fetch now: the next 48 hours of the trace */
+static void sim_forecast_refresh(void) {
+    carbon_regions[0].forecast_fetched_at = sim_clock;
+    if (!sim_forecast_enabled) return;
+    ForecastPlan *plan = malloc(sizeof(ForecastPlan) + FORECAST_MAX_SLOTS * sizeof(ForecastSlot));
+    plan->count = 0;
+    plan->fetched_at = sim_clock;
+    for (int i = sim_reading_at(sim_clock); i + 1 < sim_reading_count && plan->count < FORECAST_MAX_SLOTS; ++i) {
+        if (sim_readings[i].at >= sim_clock + 48 * 3600) break;
+        forecast_plan_add(plan, sim_readings[i].at, sim_readings[i + 1].at, sim_readings[i].forecast);
+    }
+    forecast_install(0, plan);
+}
+
+/* when the daemon's refresher would fetch next (it only does while tasks are live) */
+static time_t sim_carbon_next(void) {
+    CarbonSnapshot cur;
+    carbon_snapshot_read(0, &cur);
+    return carbon_next_fetch(0, &cur);
+}
+
+static void sim_complete(const SimCompletion *c) {
+    SimJob *j = &sim_jobs[c->job];
+    if (c->version != j->version || j->stopped) return;   /* stopped since; SIGCONT re-queued it */
+    j->intensity_sec += sim_integral(j->resumed_at, sim_clock);
+    j->finished_at = sim_clock;
+    sim_running--;
+    struct rusage ru;
+    memset(&ru, 0, sizeof(ru));
+    ru.ru_utime.tv_sec = j->runtime;   /* one busy core for the whole runtime */
+    pid_t pid = SIM_PID_BASE + c->job;
+    tasks_lock_acquire();
+    int slot = pid_map_take(pid);
+    if (slot >= 0) task_complete(slot, pid, sim_clock, 0, &ru);
+    tasks_lock_release();
+}
+
+/* every arrival due by now goes in as one request through the daemon's ingest queue */
+static int sim_ingest(int next) {
+    if (next >= sim_job_count || sim_jobs[next].arrival > sim_clock) return next;
+    struct http_cb_ctx *ctx = http_cb_ctx_new();
+    char cmd[32];
+    for (; next < sim_job_count && sim_jobs[next].arrival <= sim_clock; ++next) {
+        SimJob *j = &sim_jobs[next];
+        snprintf(cmd, sizeof(cmd), "sim %d", next);
+        staged_list_push(ctx, &ctx->staged[j->urgency], (StagedTask){ command_compile(cmd, strlen(cmd), &ctx->arena, NULL), j->urgency, j->deadline_hours, j->arrival, REGION_ANY });
+    }
+    ctx->ingest_next = ingest_head;
+    ingest_head = ctx;
+    ingest_drain(0);
+    http_cb_ctx_free(ctx);
+    return next;
+}
+
+static int compare_time(const void *a, const void *b) {
+    time_t x = *(const time_t *)a, y = *(const time_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void sim_report(double wall_sec, time_t first, time_t last) {
+    time_t *wait[URGENCY_COUNT];
+    int count[URGENCY_COUNT] = {0}, late[URGENCY_COUNT] = {0};
+    double scheduled = 0, immediate = 0;
+    for (int r = 0; r < URGENCY_COUNT; ++r) wait[r] = malloc(sizeof(time_t) * (sim_job_count + 1));
+    for (int i = 0; i < sim_job_count; ++i) {
+        const SimJob *j = &sim_jobs[i];
+        if (j->finished_at == 0) continue;
+        wait[j->urgency][count[j->urgency]++] = j->started_at - j->arrival;
+        if (j->urgency != URGENCY_HIGH && j->started_at > j->arrival + (time_t)j->deadline_hours * 3600) late[j->urgency]++;
+        scheduled += j->intensity_sec;
+        immediate += sim_integral(j->arrival, j->arrival + j->runtime);
+    }
+    double to_gco2 = CPU_WATTS_PER_CORE / 3.6e6;
+    double estimate = 0;
+    for (int r = 0; r < URGENCY_COUNT; ++r) estimate += usage_totals[r].gco2;
+    struct tm tm;
+    char from[32], to[32];
+    strftime(from, sizeof(from), "%Y-%m-%d %H:%M", gmtime_r(&first, &tm));
+    strftime(to, sizeof(to), "%Y-%m-%d %H:%M", gmtime_r(&last, &tm));
+    printf("simulated %s .. %s UTC (%.1f h) in %.3f s, %.0fx real time\n", from, to,
+           (double)(last - first) / 3600, wall_sec, wall_sec > 0 ? (double)(last - first) / wall_sec : 0);
+    printf("tasks          %d completed of %d (high %d, medium %d, low %d)\n", completed_tasks, sim_job_count,
+           count[URGENCY_HIGH], count[URGENCY_MEDIUM], count[URGENCY_LOW]);
+    printf("gCO2           %.3f scheduled vs %.3f run on arrival (%+.1f%%); daemon estimate %.3f\n",
+           scheduled * to_gco2, immediate * to_gco2, immediate > 0 ? (scheduled - immediate) * 100 / immediate : 0, estimate);
+    printf("deadline miss  medium %d, low %d (started after the deadline)\n", late[URGENCY_MEDIUM], late[URGENCY_LOW]);
+    printf("peak           %d running, %d running or suspended\n", sim_peak_running, sim_peak_busy);
+    printf("queue wait s   %-8s %-10s %-10s %-10s %-10s\n", "urgency", "p50", "p90", "p99", "max");
+    for (int r = 0; r < URGENCY_COUNT; ++r) {
+        int n = count[r];
+        if (n > 0) {
+            qsort(wait[r], n, sizeof(time_t), compare_time);
+            printf("               %-8s %-10lld %-10lld %-10lld %-10lld\n", urgency_name(r), (long long)wait[r][n / 2],
+                   (long long)wait[r][(int)(n * 0.9)], (long long)wait[r][(int)(n * 0.99)], (long long)wait[r][n - 1]);
+        }
+        free(wait[r]);
+    }
+}
+
+static void sim_usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s --intensity FILE --tasks FILE [--max-running-high N] [--max-running-medium N]\n"
+            "          [--max-running-low N] [--preempt high|very-high] [--no-forecast]\n"
+            "  --intensity      carbon intensity trace: time,gco2_per_kwh[,index]\n"
+            "  --tasks          task arrival trace: arrival_time,urgency,deadline_hours,runtime_seconds\n"
+            "  --max-running-*  concurrent children per urgency class (default %d/%d/%d)\n"
+            "  --preempt        stop running non-urgent tasks at this carbon level (default off)\n"
+            "  --no-forecast    schedule without a forecast plan (defer while high only)\n",
+            prog, DEFAULT_MAX_RUNNING_HIGH, DEFAULT_MAX_RUNNING_MEDIUM, DEFAULT_MAX_RUNNING_LOW);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option opts[] = {
+        { "intensity", required_argument, NULL, 'i' },
+        { "tasks", required_argument, NULL, 't' },
+        { "max-running-high", required_argument, NULL, 'H' },
+        { "max-running-medium", required_argument, NULL, 'M' },
+        { "max-running-low", required_argument, NULL, 'L' },
+        { "preempt", required_argument, NULL, 'p' },
+        { "no-forecast", no_argument, NULL, 'n' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char *intensity_path = NULL, *tasks_path = NULL;
+    int opt, bad = 0;
+    while ((opt = getopt_long(argc, argv, "", opts, NULL)) != -1) {
+        switch (opt) {
+        case 'i': intensity_path = optarg; break;
+        case 't': tasks_path = optarg; break;
+        case 'H': bad |= parse_positive(optarg, &max_running[URGENCY_HIGH]) != 0; break;
+        case 'M': bad |= parse_positive(optarg, &max_running[URGENCY_MEDIUM]) != 0; break;
+        case 'L': bad |= parse_positive(optarg, &max_running[URGENCY_LOW]) != 0; break;
+        case 'p':
+            if (strcmp(optarg, "high") == 0) preempt_level = CARBON_HIGH;
+            else if (strcmp(optarg, "very-high") == 0) preempt_level = CARBON_VERY_HIGH;
+            else bad = 1;
+            break;
+        case 'n': sim_forecast_enabled = 0; break;
+        default: bad = 1;
+        }
+    }
+    if (bad || optind != argc || !intensity_path || !tasks_path) { sim_usage(argv[0]); return 2; }
+    if (sim_load_intensity(intensity_path) != 0 || sim_load_tasks(tasks_path) != 0) return 1;
+    if (sim_job_count == 0) { fprintf(stderr, "%s: no tasks\n", tasks_path); return 1; }
+
+    /* the daemon's main loop, with every wait replaced by a jump to the next event */
+    double t0 = mono_us() / 1e6;
+    sim_clock = sim_jobs[0].arrival < sim_readings[0].at ? sim_jobs[0].arrival : sim_readings[0].at;
+    time_t first = sim_clock, timer_at = 0, status_logged_at = 0;
+    LaunchBatch batch = {0};
+    sim_carbon_refresh();   /* startup fetches */
+    sim_forecast_refresh();
+    int next_arrival = 0;
+    for (;;) {
+        int live = __atomic_load_n(&task_live, __ATOMIC_RELAXED);
+        time_t t = 0;
+        if (next_arrival < sim_job_count) t = sim_jobs[next_arrival].arrival;
+        if (sim_done_count > 0 && (t == 0 || sim_done[0].at < t)) t = sim_done[0].at;
+        if (live > 0 && timer_at > 0 && (t == 0 || timer_at < t)) t = timer_at;
+        time_t refresh_at = sim_carbon_next();
+        if (live > 0 && (t == 0 || refresh_at < t)) t = refresh_at;
+        if (t == 0) break;   /* no arrivals left and nothing live */
+        if (t > sim_clock) sim_clock = t;
+
+        while (sim_done_count > 0 && sim_done[0].at <= sim_clock) {
+            SimCompletion c = sim_done_pop();
+            sim_complete(&c);
+        }
+        next_arrival = sim_ingest(next_arrival);
+        if (__atomic_load_n(&task_live, __ATOMIC_RELAXED) > 0 && sim_clock >= sim_carbon_next()) {
+            sim_carbon_refresh();
+            if (sim_clock - carbon_regions[0].forecast_fetched_at >= FORECAST_REFRESH) sim_forecast_refresh();
+            preempt_pass();
+        }
+        timer_at = scheduler_step(&batch, sim_clock, &status_logged_at);
+    }
+    sim_report(mono_us() / 1e6 - t0, first, sim_clock);
+    free(batch.items);
+    free(sim_jobs);
+    free(sim_readings);
+    free(sim_done);
+    return 0;
+}
@@ -1,4 +1,5 @@
 import os
+import time
 import pandas as pd
 import numpy as np
 import matplotlib.pyplot as plt
@@ -6,11 +7,29 @@ from datetime import datetime
 from matplotlib.animation import FuncAnimation
 
 LOG_PATH = "/tmp/scheduler.log"
+EVENT_PREFIX = "/tmp/scheduler_events"
+WINDOW_SECONDS = 6 * 3600  # history plotted; older events are dropped
 
-def parse_log_to_dataframe():
+# Binary event log written by legacy_c_code/main_code.c (layout in event_log.h):
+# fixed 64-byte records after a 64-byte segment header, plus one 32-byte index
+# entry per segment. Intensity records carry their region name in "command".
+EVENT_HEADER_SIZE = 64
+EVENT_DTYPE = np.dtype([
+    ("ts_ms", "<i8"), ("type", "u1"), ("urgency", "u1"), ("level", "u1"), ("delayed", "u1"),
+    ("pid", "<i4"), ("slot", "<u4"), ("gen", "<u4"), ("forecast", "<i4"), ("delay", "<f4"),
+    ("key_hash", "<u8"), ("command", "S24"),
+])
+INDEX_DTYPE = np.dtype([
+    ("segment_seq", "<u8"), ("first_record", "<u8"), ("first_ts_ms", "<i8"), ("reserved", "<u8"),
+])
+EVENT_COMPLETED, EVENT_INTENSITY = 4, 5
+LEVEL_NAMES = {1: "low", 2: "moderate", 3: "high", 4: "very high"}
+COLUMNS = ["timestamp","event","task","delay","intensity","region"]
+
+def parse_log_to_dataframe(since):
     data = []
     if not os.path.exists(LOG_PATH):
-        return pd.DataFrame(columns=["timestamp","event","task","delay","intensity"])
+        return pd.DataFrame(columns=COLUMNS)
     with open(LOG_PATH, "r") as f:
         for line in f:
             if "[TASK] Completed:" in line:
@@ -18,19 +37,97 @@ def parse_log_to_dataframe():
                     timestamp = line.split("]")[0].strip("[")
                     task = line.split("Completed:")[1].split("|")[0].strip()
                     delay = float(line.strip().split("Delay:")[-1].split()[0])
-                    data.append([timestamp, "completed", task, delay, None])
+                    data.append([timestamp, "completed", task, delay, None, None])
                 except Exception:
                     pass
             elif "Carbon Intensity Level:" in line:
                 try:
                     timestamp = line.split("]")[0].strip("[")
                     intensity = line.split("Level:")[1].split("|")[0].strip().lower()
-                    data.append([timestamp, "intensity", None, None, intensity])
+                    region = line.split("Region:")[1].strip() if "Region:" in line else "default"
+                    data.append([timestamp, "intensity", None, None, intensity, region])
                 except Exception:
                     pass
-    df = pd.DataFrame(data, columns=["timestamp","event","task","delay","intensity"])
+    df = pd.DataFrame(data, columns=COLUMNS)
     df["timestamp"] = pd.to_datetime(df["timestamp"], errors="coerce")
-    return df.dropna(subset=["timestamp"])
+    df = df.dropna(subset=["timestamp"])
+    return df[df["timestamp"] >= since]
+
+class EventLogTail:
+    """Reads the binary event log incrementally, resuming at the last record seen."""
+
+    def __init__(self, prefix=EVENT_PREFIX):
+        self.prefix = prefix
+        self.next_record = 0
+        # Completion and intensity records in arrival order; buf[start:end] is the
+        # window. The array is compacted or doubled only when full, so appending
+        # costs in proportion to the new records, not to the whole history.
+        self.buf = np.empty(1024, dtype=EVENT_DTYPE)
+        self.start = self.end = 0
+
+    def available(self):
+        return os.path.exists(self.prefix + ".idx")
+
+    def _read_new(self):
+        index = np.fromfile(self.prefix + ".idx", dtype=INDEX_DTYPE)
+        chunks = []
+        for i, entry in enumerate(index):
+            first = int(entry["first_record"])
+            end = int(index["first_record"][i + 1]) if i + 1 < len(index) else None
+            if end is not None and end <= self.next_record:
+                continue
+            path = f"{self.prefix}.{int(entry['segment_seq'])}.bin"
+            if not os.path.exists(path):
+                continue  # rotated away
+            count = (os.path.getsize(path) - EVENT_HEADER_SIZE) // EVENT_DTYPE.itemsize
+            start = max(self.next_record - first, 0)
+            if count <= start:
+                continue
+            records = np.memmap(path, dtype=EVENT_DTYPE, mode="r", offset=EVENT_HEADER_SIZE, shape=(count,))
+            chunks.append(np.array(records[start:count]))
+            self.next_record = first + count
+        return np.concatenate(chunks) if chunks else np.empty(0, dtype=EVENT_DTYPE)
+
+    def _append(self, rec):
+        live = self.end - self.start
+        if self.end + rec.size > len(self.buf):
+            buf = np.empty(max(len(self.buf), 2 * (live + rec.size)), dtype=EVENT_DTYPE)
+            buf[:live] = self.buf[self.start:self.end]
+            self.buf, self.start, self.end = buf, 0, live
+        self.buf[self.end:self.end + rec.size] = rec
+        self.end += rec.size
+
+    def poll(self, since_ms):
+        rec = self._read_new()
+        # a completion with a negative status (the "forecast" slot) is a spawn that never ran
+        ran = (rec["type"] == EVENT_COMPLETED) & (rec["forecast"] >= 0)
+        self._append(rec[ran | (rec["type"] == EVENT_INTENSITY)])
+        recent = self.buf[self.start:self.end]["ts_ms"] >= since_ms
+        self.start += int(np.argmax(recent)) if recent.any() else recent.size
+        return records_to_dataframe(self.buf[self.start:self.end])
+
+def records_to_dataframe(rec):
+    completed = rec["type"] == EVENT_COMPLETED
+    names = [c.decode(errors="replace") for c in rec["command"]]
+    ts = pd.to_datetime(rec["ts_ms"], unit="ms", utc=True)
+    return pd.DataFrame({
+        "timestamp": ts.tz_convert(datetime.now().astimezone().tzinfo).tz_localize(None),
+        "event": np.where(completed, "completed", "intensity"),
+        "task": [n if done else None for n, done in zip(names, completed)],
+        "delay": np.where(completed, rec["delay"], np.nan),
+        "intensity": [None if done else LEVEL_NAMES.get(int(l)) for l, done in zip(rec["level"], completed)],
+        # daemons older than the multi-region change leave the name empty
+        "region": [None if done else (n or "default") for n, done in zip(names, completed)],
+    }, columns=COLUMNS)
+
+event_tail = EventLogTail()
+
+def load_events():
+    # Prefer the binary event log: only records appended since the last frame are read.
+    since = time.time() - WINDOW_SECONDS
+    if event_tail.available():
+        return event_tail.poll(int(since * 1000))
+    return parse_log_to_dataframe(pd.Timestamp.fromtimestamp(since))
 
 def simulate_emissions(task_delays):
     base = 50  # base gCO2/sec per task
@@ -49,7 +146,7 @@ ax_hist       = plt.subplot2grid((3,2),(1,1))
 ax_intensity  = plt.subplot2grid((3,2),(2,0), colspan=2)
 
 def update(_):
-    df = parse_log_to_dataframe()
+    df = load_events()
     for ax in [ax_emission, ax_delay_time, ax_urg_delay, ax_hist, ax_intensity]:
         ax.clear()
 
@@ -98,12 +195,17 @@ def update(_):
     else:
         ax_hist.text(0.3, 0.5, "No completions yet")
 
-    # 5️⃣ Carbon Intensity Trend
+    # 5️⃣ Carbon Intensity Trend, one line per region
     if not intensity.empty:
-        intensity["value"] = intensity["intensity"].map({
+        intensity = intensity.assign(value=intensity["intensity"].map({
             "low": 1, "moderate": 2, "high": 3, "very high": 4
-        }).fillna(0)
-        ax_intensity.plot(intensity["timestamp"], intensity["value"], color="purple", marker=".")
+        }).fillna(0))
+        regions = intensity.groupby("region")
+        for region, points in regions:
+            ax_intensity.plot(points["timestamp"], points["value"], marker=".", label=region,
+                              color="purple" if len(regions) == 1 else None)
+        if len(regions) > 1:
+            ax_intensity.legend(loc="upper left")
         ax_intensity.set_yticks([1,2,3,4])
         ax_intensity.set_yticklabels(["Low","Moderate","High","Very High"])
         ax_intensity.set_title("Carbon Intensity Trend Over Time")
@@ -1,4 +1,6 @@
-from flask import Flask, jsonify
+from flask import Flask, jsonify, abort
+from datetime import datetime, timezone
+import math
 import time
 
 app = Flask(__name__)
@@ -28,5 +30,39 @@ def intensity():
         }]
     })
 
+def forecast_at(t):
+    # Daily shape: greenest overnight, peak in the early evening, with a slow wobble
+    hour = (t % 86400) / 3600
+    return int(190 + 90 * math.cos(2 * math.pi * (hour - 18) / 24) + 25 * math.sin(t / 5400))
+
+def index_for(forecast):
+    if forecast < 120: return "low"
+    if forecast < 200: return "moderate"
+    if forecast < 280: return "high"
+    return "very high"
+
+@app.route("/intensity/<start>/fw48h")
+def intensity_fw48h(start):
+    # 48h forecast in half-hour slots, starting with the slot that contains `start`
+    try:
+        t0 = datetime.strptime(start, "%Y-%m-%dT%H:%MZ").replace(tzinfo=timezone.utc).timestamp()
+    except ValueError:
+        abort(400)
+    t0 = int(t0) // 1800 * 1800
+    data = []
+    for i in range(96):
+        t = t0 + i * 1800
+        forecast = forecast_at(t)
+        data.append({
+            "from": time.strftime("%Y-%m-%dT%H:%MZ", time.gmtime(t)),
+            "to":   time.strftime("%Y-%m-%dT%H:%MZ", time.gmtime(t + 1800)),
+            "intensity": {
+                "forecast": forecast,
+                "actual":   None,
+                "index":    index_for(forecast)
+            }
+        })
+    return jsonify({"data": data})
+
 if __name__ == "__main__":
     app.run(host="127.0.0.1", port=5000)